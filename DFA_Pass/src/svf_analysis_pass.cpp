@@ -1,11 +1,26 @@
 #include <string>
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Analysis/MemoryBuiltins.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Pass.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/IntrinsicInst.h" // 用于检查内建函数
 
@@ -16,72 +31,615 @@
 #include "Util/Options.h"
 #include "MSSA/MemRegion.h"
 #include "MemoryModel/PointerAnalysisImpl.h"
+#include "DDA/DDAClient.h"
+#include "DDA/FlowDDA.h"
 using namespace llvm;
 using namespace SVF;
-typedef Map<NodeID, PointsTo> NodeToPTSSMap;
-typedef FIFOWorkList<NodeID> WorkList;
+
+// 按需模式: 只回答不可信调用点指针实参的查询, 不构建完整的 SVFG (Andersen 预分析仍然完整运行)
+static cl::opt<bool> DemandDriven("svf-demand-driven",
+    cl::desc("Only compute points-to sets of the pointer arguments of untrusted calls, without the full SVFG"),
+    cl::init(false));
+
+// 边界方案的缓存目录, 模块和分析选项都没变时直接使用上次的方案, 不再运行 SVF
+static cl::opt<std::string> PlanCacheDir("svf-cache-dir",
+    cl::desc("Directory that caches the bound plan of each module; empty disables the cache"),
+    cl::init(""));
+
 namespace {
 
-PointsTo& CollectPtsChain(SVFG* svfg, BVDataPTAImpl* pta, NodeID id, NodeToPTSSMap& cachedPtsMap)
+// 缓存文件的格式或者方案的算法变化时递增, 旧的缓存随之失效
+const unsigned PlanCacheVersion = 3;
+
+// 指针实参可能指向的一个对象, 用分配点表示.
+// 缓存的方案只在模块不变时使用, 所以分配指令可以用它在函数中的编号来指代
+struct BoundObject {
+    std::string name;      // 用于输出
+    std::string function;  // 分配指令 (alloca, malloc/calloc/realloc 等) 所在的函数, 全局变量为空
+    std::string global;    // 全局变量的名字
+    uint64_t site;         // 分配指令在函数中按指令顺序的编号
+};
+
+// 一个 dasics_libcfg_alloc 调用点的边界方案
+struct CallSiteBound {
+    uint64_t index;  // 调用点在模块中按指令顺序的编号
+    std::vector<BoundObject> objects;
+};
+
+typedef std::vector<CallSiteBound> BoundPlan;
+
+json::Value toJSON(const BoundObject& object)
+{
+    return json::Object{{"name", object.name}, {"function", object.function}, {"global", object.global},
+                        {"site", object.site}};
+}
+
+bool fromJSON(const json::Value& value, BoundObject& object, json::Path path)
+{
+    json::ObjectMapper mapper(value, path);
+    return mapper && mapper.map("name", object.name) && mapper.map("function", object.function) &&
+           mapper.map("global", object.global) && mapper.map("site", object.site);
+}
+
+json::Value toJSON(const CallSiteBound& bound)
+{
+    return json::Object{{"index", bound.index}, {"objects", bound.objects}};
+}
+
+bool fromJSON(const json::Value& value, CallSiteBound& bound, json::Path path)
+{
+    json::ObjectMapper mapper(value, path);
+    return mapper && mapper.map("index", bound.index) && mapper.map("objects", bound.objects);
+}
+
+// 模块级的 Point-to 链索引, 所有调用点共用.
+// 以基对象为结点: 对象 b 的某个域指向对象 t 时, 连一条 b -> base(t) 的边, 对象的链就是从它出发能到达的所有对象的域.
+// 同一个强连通分量里的对象链相同, 因此共享一个 PointsTo; 分量由非递归的 Tarjan 算法按逆拓扑序求出,
+// 每个分量的链只在第一次被查询到时计算一次, 之后的查询都只是查表
+class PtsChainIndex
 {
-    SVFIR* pag = svfg->getPAG();
+public:
+    PtsChainIndex(SVFIR* pag, BVDataPTAImpl* pta) : pag(pag), pta(pta) {}
 
-    NodeID baseId = pag->getBaseObjVar(id);
-    NodeToPTSSMap::iterator it = cachedPtsMap.find(baseId);
-    if(it!=cachedPtsMap.end())
+    // 返回 id 所在的基对象的 Point-to 链
+    const PointsTo& getChain(NodeID id)
     {
-        return it->second;
+        NodeID baseId = pag->getBaseObjVar(id);
+        Map<NodeID, unsigned>::const_iterator it = sccOf.find(baseId);
+        if (it == sccOf.end()) {
+            indexFrom(baseId);
+            it = sccOf.find(baseId);
+        }
+        return sccChains[it->second];
+    }
+
+private:
+    // 外部调用返回的对象不展开
+    bool isSkipped(NodeID baseId) const
+    {
+        if (Options::CollectExtRetGlobals()) {
+            return false;
+        }
+        if (!pta->isFIObjNode(baseId) || !pag->getGNode(baseId)->hasValue()) {
+            return false;
+        }
+        ValVar* valVar = SVFUtil::dyn_cast<ValVar>(pag->getGNode(baseId));
+        return valVar && valVar->getGNode() && SVFUtil::isExtCall(SVFUtil::cast<ICFGNode>(valVar->getGNode()));
+    }
+
+    void collectSuccessors(NodeID baseId, std::vector<NodeID>& succs) const
+    {
+        if (isSkipped(baseId)) {
+            return;
+        }
+        NodeBS fields = pag->getFieldsAfterCollapse(baseId);
+        for (NodeID field : fields) {
+            const PointsTo& pts = pta->getPts(field);
+            for (PointsTo::iterator it = pts.begin(), eit = pts.end(); it != eit; ++it) {
+                succs.push_back(pag->getBaseObjVar(*it));
+            }
+        }
     }
-    else
+
+    // 从 root 出发求出所有还没有编号的分量以及它们的链
+    void indexFrom(NodeID root)
     {
-        PointsTo& pts = cachedPtsMap[baseId];
-        // base object
-        if (!Options::CollectExtRetGlobals())
-        {
-            if(pta->isFIObjNode(baseId) && pag->getGNode(baseId)->hasValue())
-            {
-                ValVar* valVar = SVFUtil::dyn_cast<ValVar>(pag->getGNode(baseId));
-                if(valVar && valVar->getGNode() && SVFUtil::isExtCall(SVFUtil::cast<ICFGNode>(valVar->getGNode())))
-                {
-                    return pts;
+        struct Frame {
+            NodeID node;
+            size_t next;
+        };
+        Map<NodeID, std::vector<NodeID>> succsOf;
+        Map<NodeID, unsigned> dfsIndex;
+        Map<NodeID, unsigned> lowLink;
+        Set<NodeID> onStack;
+        std::vector<NodeID> stack;
+        std::vector<Frame> frames;
+
+        auto visit = [&](NodeID node) {
+            unsigned index = dfsIndex.size();
+            dfsIndex[node] = index;
+            lowLink[node] = index;
+            stack.push_back(node);
+            onStack.insert(node);
+            collectSuccessors(node, succsOf[node]);
+            frames.push_back({node, 0});
+        };
+
+        visit(root);
+        while (!frames.empty()) {
+            NodeID node = frames.back().node;
+            const std::vector<NodeID>& succs = succsOf[node];
+            if (frames.back().next < succs.size()) {
+                NodeID succ = succs[frames.back().next++];
+                if (sccOf.count(succ)) {
+                    continue;
+                }
+                if (!dfsIndex.count(succ)) {
+                    visit(succ);
+                } else if (onStack.count(succ)) {
+                    lowLink[node] = std::min(lowLink[node], dfsIndex[succ]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty()) {
+                NodeID parent = frames.back().node;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+            }
+            if (lowLink[node] != dfsIndex[node]) {
+                continue;
+            }
+
+            // node 是分量的根, 栈上它之后的结点都属于这个分量, 它们能到达的其他分量都已经算好了
+            unsigned scc = sccChains.size();
+            std::vector<NodeID> members;
+            NodeID top;
+            do {
+                top = stack.back();
+                stack.pop_back();
+                onStack.erase(top);
+                sccOf[top] = scc;
+                members.push_back(top);
+            } while (top != node);
+
+            PointsTo chain;
+            for (NodeID member : members) {
+                if (!isSkipped(member)) {
+                    chain |= pag->getFieldsAfterCollapse(member);
+                }
+                for (NodeID succ : succsOf[member]) {
+                    unsigned succScc = sccOf[succ];
+                    if (succScc != scc) {
+                        chain |= sccChains[succScc];
+                    }
+                }
+            }
+            sccChains.push_back(std::move(chain));
+        }
+    }
+
+    SVFIR* pag;
+    BVDataPTAImpl* pta;
+    Map<NodeID, unsigned> sccOf;      // 基对象 -> 所在分量
+    std::vector<PointsTo> sccChains;  // 分量 -> 分量中对象的 Point-to 链
+};
+
+// PragmaHandler 把 #pragma untrusted_call 改写成下面两种调用, 指针实参都被强制转换成了 uint64_t:
+//   X_handler = dasics_libcfg_alloc(perm, (uint64_t)X, (uint64_t)X + sizeof(X) - 1);
+//   lib_call(&func, (uint64_t)X);
+// 这里取出被转换前的指针, 作为按需查询的对象
+void CollectUntrustedPointerArgs(const CallBase* Call, std::vector<const Value*>& ptrs)
+{
+    const Function* Callee = Call->getCalledFunction();
+    if (!Callee) {
+        return;
+    }
+    unsigned firstArg;
+    unsigned lastArg;
+    if (Callee->getName() == "lib_call") {
+        // 第 0 个参数是不可信函数本身
+        firstArg = 1;
+        lastArg = Call->arg_size();
+    } else if (Callee->getName() == "dasics_libcfg_alloc") {
+        // 只看下界, 上界是由同一个指针算出来的
+        firstArg = 1;
+        lastArg = 2;
+    } else {
+        return;
+    }
+    for (unsigned i = firstArg; i < lastArg && i < Call->arg_size(); ++i) {
+        const Value* V = Call->getArgOperand(i);
+        if (const auto* P2I = dyn_cast<PtrToIntOperator>(V)) {
+            V = P2I->getPointerOperand();
+        }
+        if (V->getType()->isPointerTy()) {
+            ptrs.push_back(V);
+        }
+    }
+}
+
+// 打印一个指针的 Point-to Set, 以及其中每个对象可以继续到达的对象
+void PrintPtsChain(SVFIR* pag, PtsChainIndex& chains, const PointsTo& pts)
+{
+    for (PointsTo::iterator ii = pts.begin(), ie = pts.end();ii != ie; ii++){
+        outs() << "GNode: " << *ii << " \n";
+        PAGNode* targetObj = pag->getGNode(*ii);
+        const PointsTo& ptsChain = chains.getChain(targetObj->getId());
+        for (PointsTo::iterator ptc = ptsChain.begin(), ptce = ptsChain.end();ptc != ptce; ptc++){
+            outs() << "ptsChain:" << *ptc << " \n";
+            PAGNode* a =  pag->getGNode(*ptc);
+            if(a->hasValue()){
+                outs() << "ptsChain -> :" << a->getValue()->toString() << ")\t" << a->toString()  << "\n";
+            }
+        }
+    }
+}
+
+// 按需模式: 只为不可信调用点的指针实参求 Point-to Set.
+// FlowDDA 在 Andersen 的结果上构建只含顶层指针的 SVFG, 再从查询的指针出发沿值流反向求解,
+// 不构建完整 SVFG 中针对全部内存对象的 MemSSA. 注意作为预分析的 Andersen 仍然对整个模块完整地运行一遍,
+// 省下的只是 SVFG 的部分, 总的耗时能减少多少取决于模块, 没有测量过
+void AnswerUntrustedQueries(Module& M, SVFModule* svfModule, SVFIR* pag, Map<NodeID, PointsTo>& answers)
+{
+    std::vector<const Value*> ptrs;
+    for (Function &F : M) {
+        for (BasicBlock &BB : F) {
+            for (Instruction &I : BB) {
+                if (auto *Call = dyn_cast<CallBase>(&I)) {
+                    CollectUntrustedPointerArgs(Call, ptrs);
+                }
+            }
+        }
+    }
+
+    DDAClient client(svfModule);
+    std::vector<std::pair<const Value*, NodeID>> queries;
+    for (const Value* V : ptrs) {
+        const SVFValue* svfValue = LLVMModuleSet::getLLVMModuleSet()->getSVFValue(V);
+        if (!pag->hasValueNode(svfValue)) {
+            errs() << "No SVFIR node for untrusted argument " << *V << "\n";
+            continue;
+        }
+        NodeID id = pag->getValueNode(svfValue);
+        client.setQuery(id);
+        queries.emplace_back(V, id);
+    }
+    outs() << "Untrusted pointer arguments: " << queries.size() << "\n";
+    if (queries.empty()) {
+        return;
+    }
+
+    FlowDDA dda(pag, &client);
+    dda.initialize();
+    // FlowDDA 内部的 Andersen 是单例, 这里拿到的是同一个实例, 用来展开对象内部的指针
+    Andersen* ander = AndersenWaveDiff::createAndersenWaveDiff(pag);
+    PtsChainIndex chains(pag, ander);
+    for (const auto& query : queries) {
+        dda.computeDDAPts(query.second);
+        outs() << "pagNode:" << pag->getGNode(query.second)->toString() << "\n";
+        outs() << "4. ---------  迭代当前实参的Point-to Set -----------\n";
+        PrintPtsChain(pag, chains, dda.getPts(query.second));
+        outs() << "4. ---------  end -----------\n";
+        answers[query.second] = dda.getPts(query.second);
+    }
+    dda.finalize();
+}
+
+// 按指令顺序收集模块中所有 dasics_libcfg_alloc 调用, 下标就是 CallSiteBound::index
+void CollectLibcfgAllocs(Module& M, std::vector<CallInst*>& calls)
+{
+    for (Function &F : M) {
+        for (BasicBlock &BB : F) {
+            for (Instruction &I : BB) {
+                if (auto *Call = dyn_cast<CallInst>(&I)) {
+                    Function *Callee = Call->getCalledFunction();
+                    if (Callee && Callee->getName() == "dasics_libcfg_alloc") {
+                        calls.push_back(Call);
+                    }
                 }
             }
         }
+    }
+}
+
+// 对象大小引擎: 把 Point-to 目标还原成分配点 (alloca, 全局变量, malloc/calloc/realloc 等).
+// 对象的字节大小 (常量, 或者变长数组, malloc(n) 等运行时才知道的大小) 在改写时
+// 由 ObjectSizeOffsetEvaluator 在分配点求出, 方案里只记录分配点
+class ObjectSizeEngine
+{
+public:
+    explicit ObjectSizeEngine(Module& M) : M(M) {}
+
+    // 给所有指令编号, 之后才能调用 describe
+    void prepareForQueries()
+    {
+        for (Function& F : M) {
+            if (F.isDeclaration()) {
+                continue;
+            }
+            uint64_t index = 0;
+            for (const Instruction& I : instructions(F)) {
+                siteIndex[&I] = index++;
+            }
+        }
+    }
+
+    // 生成方案时使用: 把 SVF 的对象结点还原成分配点. 需要先调用 prepareForQueries.
+    BoundObject describe(const PAGNode* node) const
+    {
+        BoundObject object;
+        object.name = node->toString();
+        object.site = 0;
+        const Value* V = node->hasValue() ? LLVMModuleSet::getLLVMModuleSet()->getLLVMValue(node->getValue()) : nullptr;
+        if (const auto* GV = dyn_cast_or_null<GlobalVariable>(V)) {
+            object.name = GV->getName().str();
+            object.global = object.name;
+        } else if (const auto* I = dyn_cast_or_null<Instruction>(V)) {
+            object.function = I->getFunction()->getName().str();
+            object.site = siteIndex.lookup(I);
+        }
+        return object;
+    }
+
+    // 改写时使用: 找回方案中对象的分配点, 找不到时返回空指针
+    Value* resolve(const BoundObject& object)
+    {
+        if (!object.global.empty()) {
+            return M.getNamedGlobal(object.global);
+        }
+        if (object.function.empty()) {
+            return nullptr;
+        }
+        std::vector<Instruction*>& sites = sitesOf[object.function];
+        if (sites.empty()) {
+            Function* F = M.getFunction(object.function);
+            if (!F) {
+                return nullptr;
+            }
+            for (Instruction& I : instructions(*F)) {
+                sites.push_back(&I);
+            }
+        }
+        return object.site < sites.size() ? sites[object.site] : nullptr;
+    }
+
+private:
+    Module& M;
+    DenseMap<const Instruction*, uint64_t> siteIndex;
+    StringMap<std::vector<Instruction*>> sitesOf;
+};
+
+// 根据指针分析的结果为每个 dasics_libcfg_alloc 调用点生成边界方案, 改写 IR 在 ApplyBoundPlan 中进行.
+// 生成方案是顺序的: 耗时的部分 (SVF 的 getPts, 以及 describe 中的 toString 和 getLLVMValue) 都不是线程安全的,
+// 剩下能并行的只有把 Point-to Set 归并成基对象, 不值得用线程池
+void BuildBoundPlan(Module& M, SVFIR* pag, function_ref<const PointsTo&(NodeID)> getPts, BoundPlan& plan)
+{
+    ObjectSizeEngine engine(M);
+    engine.prepareForQueries();
+    std::vector<CallInst*> calls;
+    CollectLibcfgAllocs(M, calls);
+
+    plan.resize(calls.size());
+    DenseMap<NodeID, BoundObject> objects;
+    for (size_t i = 0; i < calls.size(); ++i) {
+        plan[i].index = i;
+
+        // 调用点所有不可信指针实参的 Point-to Set 的并集
+        PointsTo pts;
+        std::vector<const Value*> ptrs;
+        CollectUntrustedPointerArgs(calls[i], ptrs);
+        for (const Value* V : ptrs) {
+            const SVFValue* svfValue = LLVMModuleSet::getLLVMModuleSet()->getSVFValue(V);
+            if (pag->hasValueNode(svfValue)) {
+                pts |= getPts(pag->getValueNode(svfValue));
+            }
+        }
+
+        // 同一个对象的不同域是同一个分配点, 每个基对象只还原一次
+        Set<NodeID> bases;
+        for (PointsTo::iterator ii = pts.begin(), ie = pts.end(); ii != ie; ii++) {
+            NodeID baseId = pag->getBaseObjVar(*ii);
+            if (!bases.insert(baseId).second) {
+                continue;
+            }
+            auto it = objects.find(baseId);
+            if (it == objects.end()) {
+                it = objects.try_emplace(baseId, engine.describe(pag->getGNode(baseId))).first;
+            }
+            plan[i].objects.push_back(it->second);
+        }
+    }
+}
+
+// 按方案改写 dasics_libcfg_alloc 的下界和上界, 为指针所在的对象开一个最紧的窗口:
+//   1. 沿 SSA 能找到指针的分配点时, 窗口从指针本身到对象末尾, 大小和偏移都可以是运行时的值.
+//      偏移不在对象内 (越界的 GEP) 时保留源码里的上界;
+//   2. 否则指针分析只给出一个分配点, 并且它是全局变量时, 上界是对象末尾,
+//      下界取源码里的下界和对象起始地址中较大的一个 (指针可能指向对象中间).
+//      alloca 和 malloc 等分配点可能执行多次 (循环, 递归), Andersen 把每次执行的结果合成一个对象,
+//      在调用点能用到的只是最近一次分配的结果, 不一定是指针所在的那一个, 所以不用它们开窗口;
+//   3. 都不满足时保留源码里的边界.
+// 返回是否改动了 IR
+bool ApplyBoundPlan(Module& M, const BoundPlan& plan, FunctionAnalysisManager& FAM)
+{
+    ObjectSizeEngine engine(M);
+    std::vector<CallInst*> calls;
+    CollectLibcfgAllocs(M, calls);
+    // 改写会插入新的指令, 先把所有分配点找回来
+    std::vector<Value*> bases(plan.size(), nullptr);
+    for (size_t i = 0; i < plan.size(); ++i) {
+        if (plan[i].objects.size() == 1) {
+            bases[i] = engine.resolve(plan[i].objects.front());
+        }
+    }
 
-        pts |= pag->getFieldsAfterCollapse(baseId);
+    bool changed = false;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        const CallSiteBound& bound = plan[i];
+        if (bound.index >= calls.size()) {
+            continue;
+        }
+        CallInst* Call = calls[bound.index];
+        errs() << "Found call to dasics_libcfg_alloc:\n";
+        Call->print(errs());
+        errs() << "\n";
 
-        WorkList worklist;
-        for(PointsTo::iterator it = pts.begin(), eit = pts.end(); it!=eit; ++it)
-            worklist.push(*it);
+        Function& F = *Call->getFunction();
+        const TargetLibraryInfo& TLI = FAM.getResult<TargetLibraryAnalysis>(F);
+        ObjectSizeOffsetEvaluator evaluator(M.getDataLayout(), &TLI, M.getContext());
+        llvm::IRBuilder<> Builder(Call);
+        Type* Int64Ty = Builder.getInt64Ty();
 
-        while(!worklist.empty())
-        {
-            NodeID nodeId = worklist.pop();
-            const PointsTo& tmp = pta->getPts(nodeId);
-            for(PointsTo::iterator it = tmp.begin(), eit = tmp.end(); it!=eit; ++it)
-            {
-                pts |= CollectPtsChain(svfg, pta,*it,cachedPtsMap);
+        std::vector<const Value*> ptrs;
+        CollectUntrustedPointerArgs(Call, ptrs);
+        SizeOffsetEvalType sizeOffset = ObjectSizeOffsetEvaluator::unknown();
+        if (!ptrs.empty()) {
+            sizeOffset = evaluator.compute(const_cast<Value*>(ptrs.front()));
+        }
+        if (evaluator.bothKnown(sizeOffset)) {
+            Value* size = Builder.CreateZExtOrTrunc(sizeOffset.first, Int64Ty);
+            Value* offset = Builder.CreateZExtOrTrunc(sizeOffset.second, Int64Ty);
+            // 偏移是有符号数, 按无符号数比较时负的偏移也落在对象之外
+            Value* inBounds = Builder.CreateICmpULT(offset, size);
+            if (auto* inBoundsConst = dyn_cast<ConstantInt>(inBounds); inBoundsConst && inBoundsConst->isZero()) {
+                errs() << "Keeping the bounds of 'dasics_libcfg_alloc': pointer is outside its object.\n";
+                continue;
+            }
+            Value* rest = Builder.CreateSub(size, offset);
+            Value* upper = Builder.CreateAdd(Call->getArgOperand(1), Builder.CreateSub(rest, Builder.getInt64(1)));
+            Call->setArgOperand(2, Builder.CreateSelect(inBounds, upper, Call->getArgOperand(2)));
+        } else {
+            Value* base = bases[i];
+            sizeOffset = isa_and_nonnull<GlobalVariable>(base) ? evaluator.compute(base)
+                                                               : ObjectSizeOffsetEvaluator::unknown();
+            if (!evaluator.bothKnown(sizeOffset)) {
+                errs() << "Keeping the bounds of 'dasics_libcfg_alloc': object size unknown.\n";
+                continue;
             }
+            Value* begin = Builder.CreatePtrToInt(base, Int64Ty);
+            Value* size = Builder.CreateZExtOrTrunc(sizeOffset.first, Int64Ty);
+            Value* lower = Call->getArgOperand(1);
+            Call->setArgOperand(1, Builder.CreateSelect(Builder.CreateICmpUGT(lower, begin), lower, begin));
+            Call->setArgOperand(2, Builder.CreateAdd(begin, Builder.CreateSub(size, Builder.getInt64(1))));
         }
-        return pts;
+        changed = true;
+        errs() << "Replaced bounds in call to 'dasics_libcfg_alloc'.\n";
+        Call->print(errs());
     }
+    return changed;
 }
 
+// 影响方案的选项: 本 pass 自己的选项, 以及 SVF 中影响指针分析结果的选项.
+// Andersen 的变种固定是 AndersenWaveDiff, 变化时需要递增 PlanCacheVersion
+std::string GetAnalysisOptionsKey()
+{
+    std::string key;
+    raw_string_ostream os(key);
+    os << "version=" << PlanCacheVersion << ";demand=" << (DemandDriven ? 1 : 0)
+       << ";andersen=wave-diff"
+       << ";field-limit=" << Options::MaxFieldLimit()
+       << ";model-consts=" << Options::ModelConsts()
+       << ";model-arrays=" << Options::ModelArrays()
+       << ";ff-eq-base=" << Options::FirstFieldEqBase()
+       << ";blk=" << Options::HandBlackHole();
+    if (DemandDriven) {
+        // FlowDDA 超出预算时退回 Andersen 的结果
+        os << ";max-path=" << Options::MaxPathLen();
+    }
+    return os.str();
+}
+
+// 缓存文件名是模块的 bitcode 和影响方案的选项的 SHA1, 不使用缓存时返回空串.
+// SVF 分析的也是内存中的 M (见 run 中的 buildSVFModule), 所以键和分析的输入一致
+std::string GetPlanCachePath(const Module& M)
+{
+    if (PlanCacheDir.empty()) {
+        return "";
+    }
+    SmallVector<char, 0> bitcode;
+    raw_svector_ostream os(bitcode);
+    WriteBitcodeToFile(M, os);
+
+    SHA1 hasher;
+    hasher.update(StringRef(bitcode.data(), bitcode.size()));
+    hasher.update(GetAnalysisOptionsKey());
+    SmallString<128> path(PlanCacheDir.getValue());
+    sys::path::append(path, toHex(hasher.final(), true) + ".json");
+    return std::string(path);
+}
+
+bool LoadBoundPlan(const std::string& path, BoundPlan& plan)
+{
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return false;
+    }
+    Expected<json::Value> root = json::parse((*buffer)->getBuffer());
+    if (!root) {
+        errs() << "Ignoring broken bound plan cache " << path << ": " << toString(root.takeError()) << "\n";
+        return false;
+    }
+    json::Path::Root pathRoot;
+    if (!fromJSON(*root, plan, pathRoot)) {
+        errs() << "Ignoring broken bound plan cache " << path << "\n";
+        plan.clear();
+        return false;
+    }
+    return true;
+}
+
+void StoreBoundPlan(const std::string& path, const BoundPlan& plan)
+{
+    if (std::error_code ec = sys::fs::create_directories(PlanCacheDir)) {
+        errs() << "Cannot create bound plan cache directory " << PlanCacheDir << ": " << ec.message() << "\n";
+        return;
+    }
+    // 先写临时文件再改名, 同时编译的其他进程不会读到写了一半的缓存
+    int fd;
+    SmallString<128> tmpPath;
+    if (std::error_code ec = sys::fs::createUniqueFile(path + ".tmp%%%%%%", fd, tmpPath)) {
+        errs() << "Cannot write bound plan cache " << path << ": " << ec.message() << "\n";
+        return;
+    }
+    {
+        raw_fd_ostream os(fd, /*shouldClose=*/true);
+        os << json::Value(plan);
+    }
+    if (std::error_code ec = sys::fs::rename(tmpPath, path)) {
+        errs() << "Cannot write bound plan cache " << path << ": " << ec.message() << "\n";
+        sys::fs::remove(tmpPath);
+    }
+}
 
 struct SVFAnalysisPass : public PassInfoMixin<SVFAnalysisPass> {
     SVFAnalysisPass() = default;
 
     PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM) {
-        std::vector<std::string> moduleNameVec;
         auto fileName = M.getSourceFileName();
         auto bitcodeName = M.getModuleIdentifier();
-        moduleNameVec.push_back(bitcodeName);
         errs() << "File name: " << fileName << "\nBitcode name: " << bitcodeName << "\n";
 
+        BoundPlan plan;
+        std::string cachePath = GetPlanCachePath(M);
+        if (!cachePath.empty() && LoadBoundPlan(cachePath, plan)) {
+            outs() << "Bound plan cache hit: " << cachePath << "\n";
+            return ApplyBoundPlan(M, plan, GetFAM(M, MAM)) ? PreservedAnalyses::none() : PreservedAnalyses::all();
+        }
+
         //构建PAG (SVFIR)
-        SVFModule* svfModule = LLVMModuleSet::getLLVMModuleSet()->buildSVFModule(moduleNameVec);
+        // 直接分析内存中的 M 而不是重新读入 bitcode 文件: 前面的 pass 可能已经改过 M,
+        // 方案的调用点下标和缓存的键也都基于 M
+        SVFModule* svfModule = LLVMModuleSet::getLLVMModuleSet()->buildSVFModule(M);
         SVFIRBuilder builder(svfModule);
         SVFIR* pag = builder.build();
+        if (DemandDriven) {
+            Map<NodeID, PointsTo> answers;
+            AnswerUntrustedQueries(M, svfModule, pag, answers);
+            BuildBoundPlan(M, pag, [&answers](NodeID id) -> const PointsTo& { return answers[id]; },
+                           plan);
+            return StoreAndApplyBoundPlan(M, MAM, cachePath, plan);
+        }
         Andersen* ander = AndersenWaveDiff::createAndersenWaveDiff(pag);
 
         // Sparse value-flow graph (SVFG) 这里做数据流敏感了
@@ -89,6 +647,7 @@ struct SVFAnalysisPass : public PassInfoMixin<SVFAnalysisPass> {
         SVFG* svfg = svfBuilder.buildFullSVFG(ander);
         MemSSA* mssa = svfg->getMSSA();
         BVDataPTAImpl* BVpta = mssa->getPTA();
+        PtsChainIndex chains(pag, BVpta);
 
         //遍历所有函数调用点
         for(SVFIR::CSToArgsListMap::iterator it = pag->getCallSiteArgsMap().begin(),
@@ -127,48 +686,11 @@ struct SVFAnalysisPass : public PassInfoMixin<SVFAnalysisPass> {
                             return PreservedAnalyses::all();
                         }
 
-                        // 获取 Value 的类型
-                        Type *Ty = V->getType();
-                        errs() << "Type of Value: ";
-                        Ty->print(errs());
-                        errs() << "\n";
-                        const DataLayout &DL = M.getDataLayout();
-                        if (const auto *PtrTy = llvm::dyn_cast<llvm::PointerType>(Ty)) {
-                            // 使用 GEP 或上下文获取元素类型
-                            if (const llvm::GetElementPtrInst *GEP = llvm::dyn_cast<llvm::GetElementPtrInst>(V)) {
-                                llvm::Type *ElementType = GEP->getSourceElementType();
-                                errs() << "Element Type of Pointer (from GEP): ";
-                                ElementType->print(errs());
-                                errs() << "\n";
-
-                                uint64_t TypeSize = DL.getTypeSizeInBits(ElementType) / 8;
-                                errs() << "Element Type Size (bytes): " << TypeSize << "\n";
-                            } else {
-                                errs() << "Cannot determine element type from opaque pointer.\n";
-                            }
-                        } else {
-                            // 获取元素类型的大小（以字节为单位）
-                            uint64_t TypeSize = DL.getTypeSizeInBits(Ty) / 8;
-                            errs() << "Type Size (bytes): " << TypeSize << "\n";
-                        }
-
-                        // 调用 CollectPtsChain 方法，获取 Points-To 链
+                        // 从模块级的索引里取 Points-To 链
                         const PointsTo& pts = ander->getPts(snk->getId());
                         outs() << "4. ---------  迭代当前实参的Point-to Set -----------\n";
                         //如果没有point-to 只看PAGNode本身的value就可以了（一个define statement
-                        for (PointsTo::iterator ii = pts.begin(), ie = pts.end();ii != ie; ii++){   
-                            outs() << "GNode: " << *ii << " \n";
-                            PAGNode* targetObj = pag->getGNode(*ii);
-                            NodeToPTSSMap cachedPtsMap;
-                            PointsTo& ptsChain = CollectPtsChain(svfg, BVpta, targetObj->getId() , cachedPtsMap);
-                            for (PointsTo::iterator ptc = ptsChain.begin(), ptce = ptsChain.end();ptc != ptce; ptc++){
-                                outs() << "ptsChain:" << *ptc << " \n";
-                                PAGNode* a =  pag->getGNode(*ptc);
-                                if(a->hasValue()){
-                                    outs() << "ptsChain -> :" << a->getValue()->toString() << ")\t" << a->toString()  << "\n";
-                                }
-                            }
-                        }
+                        PrintPtsChain(pag, chains, pts);
                         outs() << "4. ---------  end -----------\n";
 
 
@@ -187,37 +709,24 @@ struct SVFAnalysisPass : public PassInfoMixin<SVFAnalysisPass> {
             }
         }
 
-          // 遍历所有函数
-        for (Function &F : M) {
-            for (BasicBlock &BB : F) {
-                for (Instruction &I : BB) {
-                    // 判断是否是 CallInst
-                    if (auto *Call = dyn_cast<CallInst>(&I)) {
-                        // 判断调用的函数是否是 @dasics_libcfg_alloc
-                        if (Function *Callee = Call->getCalledFunction()) {
-                            if (Callee->getName() == "dasics_libcfg_alloc") {
-                                errs() << "Found call to dasics_libcfg_alloc:\n";
-                                Call->print(errs());
-                                errs() << "\n";
-                                 // 获取原始的第 3 个参数
-                                Value *OldArg = Call->getArgOperand(2);
-                                // 创建新的值作为替换，例如将其替换为常量整数 42
-                                llvm::IRBuilder<> Builder(Call);
-                                Value *NewArg = Builder.getInt64(42);
-                                // 替换第 3 个参数
-                                Call->setArgOperand(2, NewArg);
-                                errs() << "Replaced third argument in call to 'dasics_libcfg_alloc'.\n";
-                                Call->print(errs());
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        BuildBoundPlan(M, pag, [BVpta](NodeID id) -> const PointsTo& { return BVpta->getPts(id); },
+                       plan);
 
         //这里是利用LLVM的方法
         //delete pag; 会dump 暂时comment掉
-        return PreservedAnalyses::all();
+        return StoreAndApplyBoundPlan(M, MAM, cachePath, plan);
+    }
+
+    static FunctionAnalysisManager& GetFAM(Module &M, ModuleAnalysisManager &MAM) {
+        return MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+    }
+
+    PreservedAnalyses StoreAndApplyBoundPlan(Module &M, ModuleAnalysisManager &MAM, const std::string& cachePath,
+                                             const BoundPlan& plan) {
+        if (!cachePath.empty()) {
+            StoreBoundPlan(cachePath, plan);
+        }
+        return ApplyBoundPlan(M, plan, GetFAM(M, MAM)) ? PreservedAnalyses::none() : PreservedAnalyses::all();
     }
 };
 
@@ -0,0 +1,526 @@
+#include "AndersonPointsToAnalysis.h"
+#include "PointsToSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/NoFolder.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standalone benchmark of the Anderson points-to analysis on synthetic modules. Every run generates the same module
+// for the same options and seed, so timings and peak memory can be compared across changes to the solver. The solver
+// is configured by the usual `-anderson-*` options.
+
+namespace llvm {
+
+namespace anderson {
+
+namespace {
+
+llvm::cl::opt<unsigned> FunctionsOption { // NOLINT(cert-err58-cpp)
+  "functions",
+  llvm::cl::desc("Number of generated functions"),
+  llvm::cl::init(100)
+};
+
+llvm::cl::opt<unsigned> GlobalsOption { // NOLINT(cert-err58-cpp)
+  "globals",
+  llvm::cl::desc("Number of generated global objects"),
+  llvm::cl::init(1000)
+};
+
+llvm::cl::opt<unsigned> AllocasOption { // NOLINT(cert-err58-cpp)
+  "allocas",
+  llvm::cl::desc("Number of stack objects in each function"),
+  llvm::cl::init(32)
+};
+
+llvm::cl::opt<unsigned> LoadStoresOption { // NOLINT(cert-err58-cpp)
+  "load-stores",
+  llvm::cl::desc("Number of random loads and stores in each function"),
+  llvm::cl::init(64)
+};
+
+llvm::cl::opt<unsigned> GepChainsOption { // NOLINT(cert-err58-cpp)
+  "gep-chains",
+  llvm::cl::desc("Number of field access chains in each function"),
+  llvm::cl::init(16)
+};
+
+llvm::cl::opt<unsigned> GepDepthOption { // NOLINT(cert-err58-cpp)
+  "gep-depth",
+  llvm::cl::desc("Number of field accesses in each field access chain"),
+  llvm::cl::init(4)
+};
+
+llvm::cl::opt<unsigned> CyclesOption { // NOLINT(cert-err58-cpp)
+  "cycles",
+  llvm::cl::desc("Number of load/store cycles in each function"),
+  llvm::cl::init(4)
+};
+
+llvm::cl::opt<unsigned> CycleLengthOption { // NOLINT(cert-err58-cpp)
+  "cycle-length",
+  llvm::cl::desc("Number of objects in each load/store cycle"),
+  llvm::cl::init(8)
+};
+
+llvm::cl::opt<unsigned> PhisOption { // NOLINT(cert-err58-cpp)
+  "phis",
+  llvm::cl::desc("Number of PHI nodes in each function"),
+  llvm::cl::init(16)
+};
+
+llvm::cl::opt<unsigned> PhiIncomingOption { // NOLINT(cert-err58-cpp)
+  "phi-incoming",
+  llvm::cl::desc("Number of incoming values of each PHI node"),
+  llvm::cl::init(4)
+};
+
+llvm::cl::opt<unsigned> ArraysOption { // NOLINT(cert-err58-cpp)
+  "arrays",
+  llvm::cl::desc("Number of generated global arrays of objects"),
+  llvm::cl::init(4)
+};
+
+llvm::cl::opt<unsigned> ArraySizeOption { // NOLINT(cert-err58-cpp)
+  "array-size",
+  llvm::cl::desc("Number of objects in each global array"),
+  llvm::cl::init(4096)
+};
+
+llvm::cl::opt<unsigned> ArrayAccessesOption { // NOLINT(cert-err58-cpp)
+  "array-accesses",
+  llvm::cl::desc("Number of global array element accesses in each function, half of them with a dynamic index"),
+  llvm::cl::init(4)
+};
+
+llvm::cl::opt<unsigned> WindowOption { // NOLINT(cert-err58-cpp)
+  "window",
+  llvm::cl::desc("Number of most recently computed pointers that operands are mostly picked from (0 picks uniformly "
+                 "from all pointers of the function, which makes nearly every pointer reach every object)"),
+  llvm::cl::init(16)
+};
+
+llvm::cl::opt<unsigned> SharingOption { // NOLINT(cert-err58-cpp)
+  "sharing",
+  llvm::cl::desc("Number of consecutive functions that share a slice of the globals and global arrays, like the "
+                 "functions of a translation unit (0 shares all globals among all functions)"),
+  llvm::cl::init(25)
+};
+
+llvm::cl::opt<unsigned> ScaleOption { // NOLINT(cert-err58-cpp)
+  "scale",
+  llvm::cl::desc("Multiplier of the number of generated functions, globals and global arrays"),
+  llvm::cl::init(1)
+};
+
+llvm::cl::opt<uint64_t> SeedOption { // NOLINT(cert-err58-cpp)
+  "seed",
+  llvm::cl::desc("Seed of the generator of the synthetic module"),
+  llvm::cl::init(1)
+};
+
+llvm::cl::opt<unsigned> RepeatOption { // NOLINT(cert-err58-cpp)
+  "repeat",
+  llvm::cl::desc("Number of times the analysis is run on the generated module"),
+  llvm::cl::init(1)
+};
+
+llvm::cl::opt<std::string> EmitOption { // NOLINT(cert-err58-cpp)
+  "emit",
+  llvm::cl::desc("Write the generated module as textual IR to the specified file"),
+  llvm::cl::value_desc("path"),
+  llvm::cl::init("")
+};
+
+/**
+ * The number of pointer elements in the array field of every generated object.
+ */
+constexpr unsigned ObjectArraySize = 4;
+
+/**
+ * A small deterministic pseudo-random generator, so that the same seed generates the same module everywhere.
+ */
+class SplitMix64 {
+public:
+  explicit SplitMix64(uint64_t seed) noexcept
+    : _state(seed)
+  { }
+
+  /**
+   * Get the next random number in `[0, bound)`.
+   *
+   * @param bound the exclusive upper bound, which must not be 0.
+   * @return the random number.
+   */
+  size_t Next(size_t bound) noexcept {
+    assert(bound > 0 && "bound is 0");
+    _state += 0x9e3779b97f4a7c15;
+    auto z = _state;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return static_cast<size_t>((z ^ (z >> 31)) % bound);
+  }
+
+private:
+  uint64_t _state;
+};
+
+/**
+ * Generates a synthetic module whose size and shape are controlled by the command line options.
+ *
+ * Every object is a `%object = type { %object*, %object*, [4 x %object*] }`, so that no pointer casts are needed and
+ * every pointer in the module is a pointer to an object. Every function takes two object pointers and a selector,
+ * computes pointers in its entry block and merges them with PHI nodes in a block reached from a switch on the selector.
+ * Constant folding is disabled so that element addresses of globals are instructions rather than constant expressions.
+ *
+ * Operands are mostly picked from the pointers computed shortly before, and each group of consecutive functions only
+ * uses its own slice of the globals. Without this locality almost every pointer reaches almost every object once the
+ * module grows past a few dozen functions, and the solve time jumps by orders of magnitude instead of scaling with the
+ * module; `-window=0 -sharing=0` generates such modules on purpose.
+ */
+class SyntheticModuleGenerator {
+public:
+  explicit SyntheticModuleGenerator(llvm::LLVMContext &context) noexcept
+    : _context(context),
+      _random(SeedOption),
+      _module(nullptr),
+      _objectType(nullptr),
+      _pointerType(nullptr),
+      _globals(),
+      _arrays(),
+      _sharedGlobals(),
+      _sharedArrays(),
+      _pointers()
+  { }
+
+  NON_COPIABLE_NON_MOVABLE(SyntheticModuleGenerator)
+
+  /**
+   * Generate the module.
+   *
+   * @return the generated module.
+   */
+  std::unique_ptr<llvm::Module> Generate() noexcept {
+    auto module = std::make_unique<llvm::Module>("anderson-benchmark", _context);
+    _module = module.get();
+
+    _objectType = llvm::StructType::create(_context, "object");
+    _pointerType = llvm::PointerType::getUnqual(_objectType);
+    _objectType->setBody({ _pointerType, _pointerType, llvm::ArrayType::get(_pointerType, ObjectArraySize) });
+
+    auto numGlobals = static_cast<size_t>(GlobalsOption) * ScaleOption;
+    for (size_t i = 0; i < numGlobals; ++i) {
+      _globals.push_back(new llvm::GlobalVariable(
+          *_module, _objectType, false, llvm::GlobalValue::ExternalLinkage,
+          llvm::ConstantAggregateZero::get(_objectType), "g" + std::to_string(i)));
+    }
+    auto arrayType = llvm::ArrayType::get(_objectType, std::max(ArraySizeOption.getValue(), 1u));
+    auto numArrays = static_cast<size_t>(ArraysOption) * ScaleOption;
+    for (size_t i = 0; i < numArrays; ++i) {
+      _arrays.push_back(new llvm::GlobalVariable(
+          *_module, arrayType, false, llvm::GlobalValue::ExternalLinkage,
+          llvm::ConstantAggregateZero::get(arrayType), "a" + std::to_string(i)));
+    }
+
+    auto functionType = llvm::FunctionType::get(
+        _pointerType, { _pointerType, _pointerType, llvm::Type::getInt32Ty(_context) }, false);
+    auto numFunctions = static_cast<size_t>(FunctionsOption) * ScaleOption;
+    auto groupSize = SharingOption ? static_cast<size_t>(SharingOption) : std::max(numFunctions, size_t { 1 });
+    auto numGroups = (numFunctions + groupSize - 1) / groupSize;
+    for (size_t i = 0; i < numFunctions; ++i) {
+      _sharedGlobals = GetGroupSlice(_globals, i / groupSize, numGroups);
+      _sharedArrays = GetGroupSlice(_arrays, i / groupSize, numGroups);
+      auto func = llvm::Function::Create(
+          functionType, llvm::GlobalValue::ExternalLinkage, "f" + std::to_string(i), *_module);
+      GenerateFunction(*func);
+    }
+
+    _module = nullptr;
+    return module;
+  }
+
+private:
+  llvm::LLVMContext &_context;
+  SplitMix64 _random;
+  llvm::Module *_module;
+  llvm::StructType *_objectType;
+  llvm::PointerType *_pointerType;
+  std::vector<llvm::GlobalVariable *> _globals;
+  std::vector<llvm::GlobalVariable *> _arrays;
+
+  /**
+   * The globals and global arrays used by the function being generated.
+   */
+  llvm::ArrayRef<llvm::GlobalVariable *> _sharedGlobals;
+  llvm::ArrayRef<llvm::GlobalVariable *> _sharedArrays;
+
+  /**
+   * The object pointers available in the function being generated.
+   */
+  std::vector<llvm::Value *> _pointers;
+
+  /**
+   * Get the slice of the specified globals used by the specified group of functions. The slices of different groups
+   * are disjoint, and a slice is empty if there are fewer globals than groups.
+   */
+  static llvm::ArrayRef<llvm::GlobalVariable *> GetGroupSlice(llvm::ArrayRef<llvm::GlobalVariable *> globals,
+                                                              size_t group, size_t numGroups) noexcept {
+    auto begin = globals.size() * group / numGroups;
+    auto end = globals.size() * (group + 1) / numGroups;
+    return globals.slice(begin, end - begin);
+  }
+
+  /**
+   * Pick a pointer available in the function being generated. Like real code, operands are mostly pointers computed
+   * shortly before, occasionally any pointer of the function or a global.
+   */
+  llvm::Value* PickPointer() noexcept {
+    if (!_sharedGlobals.empty() && _random.Next(32) == 0) {
+      return _sharedGlobals[_random.Next(_sharedGlobals.size())];
+    }
+    if (WindowOption == 0 || _random.Next(16) == 0) {
+      return _pointers[_random.Next(_pointers.size())];
+    }
+    auto window = std::min(_pointers.size(), static_cast<size_t>(WindowOption));
+    return _pointers[_pointers.size() - 1 - _random.Next(window)];
+  }
+
+  /**
+   * Get the address of a random pointer field of the object pointed to by the specified pointer.
+   */
+  llvm::Value* CreateFieldAddress(llvm::IRBuilder<llvm::NoFolder> &builder, llvm::Value *object) noexcept {
+    auto field = _random.Next(2 + ObjectArraySize);
+    if (field < 2) {
+      return builder.CreateStructGEP(_objectType, object, static_cast<unsigned>(field));
+    }
+    return builder.CreateInBoundsGEP(
+        _objectType, object, { builder.getInt64(0), builder.getInt32(2), builder.getInt64(field - 2) });
+  }
+
+  void GenerateFunction(llvm::Function &func) noexcept {
+    _pointers.clear();
+    _pointers.push_back(func.getArg(0));
+    _pointers.push_back(func.getArg(1));
+    auto selector = func.getArg(2);
+
+    auto entry = llvm::BasicBlock::Create(_context, "entry", &func);
+    llvm::IRBuilder<llvm::NoFolder> builder { entry };
+
+    for (size_t i = 0; i < AllocasOption; ++i) {
+      _pointers.push_back(builder.CreateAlloca(_objectType));
+    }
+
+    for (size_t i = 0; i < ArrayAccessesOption && !_sharedArrays.empty(); ++i) {
+      auto array = _sharedArrays[_random.Next(_sharedArrays.size())];
+      auto arrayType = array->getValueType();
+      llvm::Value *index = i % 2 ? builder.CreateSExt(selector, builder.getInt64Ty())
+                                 : builder.getInt64(_random.Next(arrayType->getArrayNumElements()));
+      _pointers.push_back(builder.CreateInBoundsGEP(arrayType, array, { builder.getInt64(0), index }));
+    }
+
+    for (size_t i = 0; i < GepChainsOption; ++i) {
+      auto pointer = PickPointer();
+      for (size_t depth = 0; depth < GepDepthOption; ++depth) {
+        pointer = builder.CreateLoad(_pointerType, CreateFieldAddress(builder, pointer));
+        _pointers.push_back(pointer);
+      }
+    }
+
+    for (size_t i = 0; i < LoadStoresOption; ++i) {
+      if (_random.Next(2)) {
+        builder.CreateStore(PickPointer(), CreateFieldAddress(builder, PickPointer()));
+      } else {
+        _pointers.push_back(builder.CreateLoad(_pointerType, CreateFieldAddress(builder, PickPointer())));
+      }
+    }
+
+    // Each object in a cycle stores what it points to into the next object, so the pointee sets flow around the cycle.
+    for (size_t i = 0; i < CyclesOption && CycleLengthOption > 0; ++i) {
+      std::vector<llvm::Value *> fields;
+      for (size_t j = 0; j < CycleLengthOption; ++j) {
+        fields.push_back(builder.CreateStructGEP(_objectType, PickPointer(), 0));
+      }
+      for (size_t j = 0; j < fields.size(); ++j) {
+        auto value = builder.CreateLoad(_pointerType, fields[j]);
+        builder.CreateStore(value, fields[(j + 1) % fields.size()]);
+      }
+    }
+
+    if (PhisOption == 0 || PhiIncomingOption == 0) {
+      builder.CreateRet(PickPointer());
+      return;
+    }
+
+    auto join = llvm::BasicBlock::Create(_context, "join", &func);
+    auto switchInst = builder.CreateSwitch(selector, join, PhiIncomingOption);
+    std::vector<llvm::BasicBlock *> predecessors;
+    for (unsigned i = 0; i < PhiIncomingOption; ++i) {
+      auto predecessor = llvm::BasicBlock::Create(_context, "case", &func, join);
+      switchInst->addCase(builder.getInt32(i), predecessor);
+      llvm::BranchInst::Create(join, predecessor);
+      predecessors.push_back(predecessor);
+    }
+
+    builder.SetInsertPoint(join);
+    std::vector<llvm::Value *> phis;
+    for (size_t i = 0; i < PhisOption; ++i) {
+      auto phi = builder.CreatePHI(_pointerType, PhiIncomingOption + 1);
+      phi->addIncoming(PickPointer(), entry);
+      for (auto predecessor : predecessors) {
+        phi->addIncoming(PickPointer(), predecessor);
+      }
+      phis.push_back(phi);
+    }
+    _pointers.insert(_pointers.end(), phis.begin(), phis.end());
+    for (auto phi : phis) {
+      builder.CreateStore(phi, CreateFieldAddress(builder, PickPointer()));
+    }
+    builder.CreateRet(PickPointer());
+  }
+};
+
+double GetMillisecondsSince(std::chrono::steady_clock::time_point start) noexcept {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Reset the peak resident set size that the kernel keeps for the process, so that `GetPeakMemory` reports the peak
+ * since this call. Only Linux supports this.
+ *
+ * @return whether the peak was reset.
+ */
+bool ResetPeakMemory() noexcept {
+  auto file = std::fopen("/proc/self/clear_refs", "w");
+  if (!file) {
+    return false;
+  }
+  auto written = std::fputs("5", file) >= 0;
+  return std::fclose(file) == 0 && written;
+}
+
+/**
+ * Get the peak resident set size of the process in megabytes, since the last successful `ResetPeakMemory` if any.
+ */
+double GetPeakMemory() noexcept {
+  // The maximum in getrusage is not reset by ResetPeakMemory, the high water mark in the status file is.
+  if (auto file = std::fopen("/proc/self/status", "r")) {
+    char line[256];
+    unsigned long kilobytes;
+    auto found = false;
+    while (!found && std::fgets(line, sizeof(line), file)) {
+      found = std::sscanf(line, "VmHWM: %lu kB", &kilobytes) == 1;
+    }
+    std::fclose(file);
+    if (found) {
+      return static_cast<double>(kilobytes) / 1024;
+    }
+  }
+
+  struct rusage usage { };
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<double>(usage.ru_maxrss) / 1024;
+}
+
+int RunBenchmark() noexcept {
+  llvm::LLVMContext context;
+  auto start = std::chrono::steady_clock::now();
+  auto module = SyntheticModuleGenerator { context }.Generate();
+  auto generateMs = GetMillisecondsSince(start);
+  if (llvm::verifyModule(*module, &llvm::errs())) {
+    llvm::errs() << "error: the generated module is malformed\n";
+    return 1;
+  }
+
+  if (!EmitOption.empty()) {
+    std::error_code error;
+    llvm::raw_fd_ostream os { EmitOption, error, llvm::sys::fs::OF_Text };
+    if (error) {
+      llvm::errs() << "error: cannot write " << EmitOption << ": " << error.message() << "\n";
+      return 1;
+    }
+    module->print(os, nullptr);
+  }
+
+  size_t numInstructions = 0;
+  for (const auto &func : *module) {
+    numInstructions += func.getInstructionCount();
+  }
+  llvm::outs() << llvm::format("module: %zu functions, %zu globals, %zu instructions, generated in %.1f ms\n",
+                               module->size(), module->global_size(), numInstructions, generateMs);
+  // The peak of each run includes the generated module, which stays resident across runs.
+  auto peakPerRun = ResetPeakMemory();
+  llvm::outs() << " run     tree(ms)   constr(ms)    solve(ms)   pointees   pointers  constraints     peak(MB)\n";
+  if (!peakPerRun) {
+    llvm::outs() << "     peak(MB) is the peak of the whole process, which cannot be reset between runs here\n";
+  }
+
+  for (unsigned run = 0; run < RepeatOption; ++run) {
+    if (peakPerRun) {
+      ResetPeakMemory();
+    }
+    start = std::chrono::steady_clock::now();
+    auto solver = CreateAndersonSolver(*module);
+    auto treeMs = GetMillisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<const llvm::Function *> functions;
+    for (const auto &func : *module) {
+      functions.push_back(&func);
+    }
+    UpdateAndersonSolverOnFunctions(*solver, functions);
+    auto constraintMs = GetMillisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    solver->Solve();
+    auto solveMs = GetMillisecondsSince(start);
+
+    auto valueTree = solver->GetValueTree();
+    llvm::outs() << llvm::format("%4u %12.1f %12.1f %12.1f %10zu %10zu %12zu %12.1f\n", run, treeMs, constraintMs,
+                                 solveMs, valueTree->GetNumPointees(), valueTree->GetNumPointers(),
+                                 valueTree->GetConstraintGraph().GetNumConstraints(), GetPeakMemory());
+    if (solver->isBudgetExceeded()) {
+      llvm::outs() << llvm::format("     budget exceeded: %zu pointers widened\n", solver->GetNumWidenedPointers());
+    }
+    // Each run overwrites the statistics, so the file ends up with those of the last run.
+    WriteAndersonStatistics(*solver);
+  }
+  return 0;
+}
+
+} // namespace <anonymous>
+
+} // namespace anderson
+
+} // namespace llvm
+
+int main(int argc, char **argv) {
+  // Every run solves the generated module, so loading a snapshot instead of solving does not apply.
+  auto &options = llvm::cl::getRegisteredOptions();
+  auto snapshotOption = options.find("anderson-snapshot");
+  if (snapshotOption != options.end()) {
+    snapshotOption->second->setHiddenFlag(llvm::cl::ReallyHidden);
+  }
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Benchmark of the Anderson points-to analysis on synthetic modules\n");
+  if (snapshotOption != options.end() && snapshotOption->second->getNumOccurrences()) {
+    llvm::errs() << "error: -anderson-snapshot is not supported by the benchmark, which always solves\n";
+    return 1;
+  }
+  return llvm::anderson::RunBenchmark();
+}
@@ -1,6 +1,8 @@
 #include "AndersonPointsToAnalysis.h"
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/IntrinsicInst.h>
+#include <llvm/Support/CommandLine.h>
+#include "PointsToSnapshot.h"
 #include "PointsToSolver.h"
 
 namespace llvm {
@@ -9,95 +11,209 @@ namespace anderson {
 
 namespace {
 
+llvm::cl::opt<PointeeSetRepresentation> PointeeSetRepresentationOption { // NOLINT(cert-err58-cpp)
+  "anderson-pointee-set",
+  llvm::cl::desc("Representation of the pointee sets computed by the Anderson points-to analysis"),
+  llvm::cl::init(PointeeSetRepresentation::Adaptive),
+  llvm::cl::values(
+    clEnumValN(PointeeSetRepresentation::SortedVector, "sorted-vector", "Sorted vectors of pointee IDs"),
+    clEnumValN(PointeeSetRepresentation::SparseBitVector, "bitvector", "Sparse bitvectors of pointee IDs"),
+    clEnumValN(PointeeSetRepresentation::Adaptive, "adaptive",
+               "Sorted vectors for small sets and sparse bitvectors for large sets"))
+};
+
+llvm::cl::opt<bool> OfflineEquivalenceOption { // NOLINT(cert-err58-cpp)
+  "anderson-offline-equivalence",
+  llvm::cl::desc("Merge pointers with provably identical pointee sets before solving the Anderson points-to analysis"),
+  llvm::cl::init(true)
+};
+
+llvm::cl::opt<unsigned> NumThreadsOption { // NOLINT(cert-err58-cpp)
+  "anderson-threads",
+  llvm::cl::desc("Number of threads that solve independent parts of the Anderson points-to analysis concurrently "
+                 "(0 uses all hardware threads)"),
+  llvm::cl::init(0)
+};
+
+llvm::cl::opt<bool> IncrementalOption { // NOLINT(cert-err58-cpp)
+  "anderson-incremental",
+  llvm::cl::desc("Keep the state of the Anderson points-to analysis so that it can be updated after functions are "
+                 "changed or added"),
+  llvm::cl::init(false)
+};
+
+llvm::cl::opt<std::string> SnapshotOption { // NOLINT(cert-err58-cpp)
+  "anderson-snapshot",
+  llvm::cl::desc("Snapshot file of the solved Anderson points-to analysis, which is loaded instead of solving when it "
+                 "has been written for the same module and written after solving otherwise"),
+  llvm::cl::value_desc("path"),
+  llvm::cl::init("")
+};
+
+llvm::cl::opt<std::string> StatisticsOption { // NOLINT(cert-err58-cpp)
+  "anderson-stats",
+  llvm::cl::desc("Write statistics of the Anderson points-to solver as JSON to the specified file ('-' for stdout)"),
+  llvm::cl::value_desc("path"),
+  llvm::cl::init("")
+};
+
+llvm::cl::opt<unsigned> TimeBudgetOption { // NOLINT(cert-err58-cpp)
+  "anderson-time-budget",
+  llvm::cl::desc("Milliseconds after which the Anderson points-to solver stops propagating and widens the pointee sets "
+                 "of the pointers that have not converged (0 for no limit)"),
+  llvm::cl::value_desc("ms"),
+  llvm::cl::init(0)
+};
+
+llvm::cl::opt<unsigned> PopBudgetOption { // NOLINT(cert-err58-cpp)
+  "anderson-pop-budget",
+  llvm::cl::desc("Number of worklist pops after which the Anderson points-to solver stops propagating and widens the "
+                 "pointee sets of the pointers that have not converged (0 for no limit)"),
+  llvm::cl::init(0)
+};
+
+llvm::cl::opt<unsigned> MemoryBudgetOption { // NOLINT(cert-err58-cpp)
+  "anderson-memory-budget",
+  llvm::cl::desc("Heap usage in megabytes above which the Anderson points-to solver stops propagating and widens the "
+                 "pointee sets of the pointers that have not converged (0 for no limit)"),
+  llvm::cl::value_desc("MB"),
+  llvm::cl::init(0)
+};
+
+llvm::cl::opt<bool> SmashArraysOption { // NOLINT(cert-err58-cpp)
+  "anderson-smash-arrays",
+  llvm::cl::desc("Represent all elements of an array by a single summary element in the Anderson points-to analysis"),
+  llvm::cl::init(ValueTreeOptions { }.smashArrays)
+};
+
+llvm::cl::opt<unsigned> MaxArrayElementsOption { // NOLINT(cert-err58-cpp)
+  "anderson-max-array-elements",
+  llvm::cl::desc("Arrays with more elements than this are represented by a single summary element in the Anderson "
+                 "points-to analysis"),
+  llvm::cl::init(ValueTreeOptions { }.maxArrayElements)
+};
+
+llvm::cl::opt<unsigned> MaxFieldDepthOption { // NOLINT(cert-err58-cpp)
+  "anderson-max-field-depth",
+  llvm::cl::desc("Aggregates nested deeper than this are treated field-insensitively by the Anderson points-to "
+                 "analysis"),
+  llvm::cl::init(ValueTreeOptions { }.maxFieldDepth)
+};
+
 template <typename Instruction>
 struct PointerInstructionHandler { };
 
 template <>
 struct PointerInstructionHandler<llvm::AllocaInst> {
-  static void Handle(PointsToSolver &solver, const llvm::AllocaInst &inst) noexcept {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::AllocaInst &inst) noexcept {
     auto pointerValue = static_cast<const llvm::Value *>(&inst);
-    auto pointerNode = solver.GetValueTree()->GetValueNode(pointerValue);
+    auto pointerNode = gatherer.GetValueTree()->GetValueNode(pointerValue);
     assert(pointerNode->isPointer());
 
-    auto allocatedMemoryNode = solver.GetValueTree()->GetAllocaMemoryNode(&inst);
-    pointerNode->pointer()->AssignedAddressOf(allocatedMemoryNode->pointee());
+    auto allocatedMemoryNode = gatherer.GetValueTree()->GetAllocaMemoryNode(&inst);
+    gatherer.GetConstraintGraph().AddAssignedAddressOf(pointerNode->pointer(), allocatedMemoryNode->pointee());
   }
 };
 
 template <>
-struct PointerInstructionHandler<llvm::CallInst> {
-  static void Handle(PointsToSolver &solver, const llvm::CallInst &inst) noexcept {
-    if (llvm::isa<llvm::IntrinsicInst>(inst)) {
+struct PointerInstructionHandler<llvm::CallBase> {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::CallBase &inst) noexcept {
+    if (llvm::isa<llvm::IntrinsicInst>(inst) || inst.isInlineAsm()) {
       return;
     }
 
-    auto function = inst.getFunction();
-
-    for (unsigned i = 0; i < inst.getNumOperands(); ++i) {
-      auto param = function->getArg(i);
-      if (!param->getType()->isPointerTy()) {
-        continue;
+    auto valueTree = gatherer.GetValueTree();
+    auto &constraints = gatherer.GetConstraintGraph();
+    auto resultPtrValue = static_cast<const llvm::Value *>(&inst);
+    auto resultPtrNode = valueTree->GetValueNode(resultPtrValue);
+
+    // Arguments without a value tree, such as null pointer constants, point to nothing. Arguments beyond the parameters
+    // of the callee are variadic arguments, which are not tracked.
+    auto callee = llvm::dyn_cast<llvm::Function>(inst.getCalledOperand()->stripPointerCasts());
+    if (callee) {
+      auto numArgs = std::min<size_t>(inst.arg_size(), callee->arg_size());
+      for (unsigned i = 0; i < numArgs; ++i) {
+        auto paramNode = valueTree->GetValueNode(callee->getArg(i));
+        auto argNode = valueTree->GetValueNode(inst.getArgOperand(i));
+        if (paramNode && paramNode->isPointer() && argNode && argNode->isPointer()) {
+          constraints.AddAssignedPointer(paramNode->pointer(), argNode->pointer());
+        }
       }
 
-      auto arg = inst.getArgOperand(i);
-
-      auto paramNode = solver.GetValueTree()->GetValueNode(param);
-      auto argNode = solver.GetValueTree()->GetValueNode(arg);
-      assert(paramNode->isPointer());
-      assert(argNode->isPointer());
-
-      paramNode->pointer()->AssignedPointer(argNode->pointer());
+      auto functionReturnValueNode = valueTree->GetFunctionReturnValueNode(callee);
+      if (resultPtrNode && resultPtrNode->isPointer() &&
+          functionReturnValueNode && functionReturnValueNode->isPointer()) {
+        constraints.AddAssignedPointer(resultPtrNode->pointer(), functionReturnValueNode->pointer());
+      }
+      return;
     }
 
-    if (!function->getReturnType()->isPointerTy()) {
+    // The callees of an indirect call are the functions pointed to by the called pointer, which are only known while
+    // solving.
+    auto calleePtrNode = valueTree->GetValueNode(inst.getCalledOperand());
+    if (!calleePtrNode || !calleePtrNode->isPointer()) {
       return;
     }
-
-    auto returnPtrValue = static_cast<const llvm::Value *>(&inst);
-    auto returnPtrNode = solver.GetValueTree()->GetValueNode(returnPtrValue);
-    auto functionReturnValueNode = solver.GetValueTree()->GetFunctionReturnValueNode(function);
-    assert(functionReturnValueNode->isPointer());
-    assert(returnPtrNode->isPointer());
-
-    returnPtrNode->pointer()->AssignedPointer(functionReturnValueNode->pointer());
+    for (unsigned i = 0; i < inst.arg_size(); ++i) {
+      auto argNode = valueTree->GetValueNode(inst.getArgOperand(i));
+      if (argNode && argNode->isPointer()) {
+        constraints.AddArgumentAssigned(calleePtrNode->pointer(), argNode->pointer(), i);
+      }
+    }
+    if (resultPtrNode && resultPtrNode->isPointer()) {
+      constraints.AddAssignedReturnValue(resultPtrNode->pointer(), calleePtrNode->pointer());
+    }
   }
 };
 
+template <>
+struct PointerInstructionHandler<llvm::CallInst> : PointerInstructionHandler<llvm::CallBase> { };
+
+template <>
+struct PointerInstructionHandler<llvm::InvokeInst> : PointerInstructionHandler<llvm::CallBase> { };
+
 template <>
 struct PointerInstructionHandler<llvm::ExtractValueInst> {
-  static void Handle(PointsToSolver &solver, const llvm::ExtractValueInst &inst) noexcept {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::ExtractValueInst &inst) noexcept {
     if (!inst.getType()->isPointerTy()) {
       return;
     }
 
     auto targetPtrValue = static_cast<const llvm::Value *>(&inst);
-    auto targetPtrNode = solver.GetValueTree()->GetValueNode(targetPtrValue);
+    auto targetPtrNode = gatherer.GetValueTree()->GetValueNode(targetPtrValue);
     assert(targetPtrNode->isPointer());
 
+    // Constant aggregates without a value tree, such as zeroinitializer, hold no pointers.
     auto sourceValue = inst.getAggregateOperand();
-    auto sourcePtrNode = solver.GetValueTree()->GetValueNode(sourceValue);
+    auto sourcePtrNode = gatherer.GetValueTree()->GetValueNode(sourceValue);
+    if (!sourcePtrNode) {
+      return;
+    }
     for (auto index : inst.indices()) {
-      sourcePtrNode = sourcePtrNode->GetChild(static_cast<size_t>(index));
+      sourcePtrNode = sourcePtrNode->GetElement(static_cast<size_t>(index));
     }
     assert(sourcePtrNode->isPointer());
 
-    targetPtrNode->pointer()->AssignedPointer(sourcePtrNode->pointer());
+    gatherer.GetConstraintGraph().AddAssignedPointer(targetPtrNode->pointer(), sourcePtrNode->pointer());
   }
 };
 
 template <>
 struct PointerInstructionHandler<llvm::GetElementPtrInst> {
-  static void Handle(PointsToSolver &solver, const llvm::GetElementPtrInst &inst) noexcept {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::GetElementPtrInst &inst) noexcept {
     auto targetPtrValue = static_cast<const llvm::Value *>(&inst);
-    auto targetPtrNode = solver.GetValueTree()->GetValueNode(targetPtrValue);
+    auto targetPtrNode = gatherer.GetValueTree()->GetValueNode(targetPtrValue);
     assert(targetPtrNode->isPointer());
 
+    // Element pointers of constants without a value tree, such as null pointers, point to nothing.
     auto sourcePtrValue = inst.getPointerOperand();
-    auto sourcePtrNode = solver.GetValueTree()->GetValueNode(sourcePtrValue);
+    auto sourcePtrNode = gatherer.GetValueTree()->GetValueNode(sourcePtrValue);
+    if (!sourcePtrNode) {
+      return;
+    }
     assert(sourcePtrNode->isPointer());
 
-    std::vector<PointerIndex> indexSequence;
-    indexSequence.reserve(inst.getNumIndices());
+    llvm::SmallVector<PointerIndex, 4> indexSequence;
     for (const auto &indexValueUse : inst.indices()) {
       auto indexValue = indexValueUse.get();
       auto indexConstantInt = llvm::dyn_cast<llvm::ConstantInt>(indexValue);
@@ -108,109 +224,129 @@ struct PointerInstructionHandler<llvm::GetElementPtrInst> {
       }
     }
 
-    targetPtrNode->pointer()->AssignedElementPtr(sourcePtrNode->pointer(), std::move(indexSequence));
+    auto &indexSequences = gatherer.GetIndexSequenceTable();
+    gatherer.GetConstraintGraph().AddAssignedElementPtr(targetPtrNode->pointer(), sourcePtrNode->pointer(),
+                                                        indexSequences.Intern(indexSequence));
   }
 };
 
 template <>
 struct PointerInstructionHandler<llvm::LoadInst> {
-  static void Handle(PointsToSolver &solver, const llvm::LoadInst &inst) noexcept {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::LoadInst &inst) noexcept {
     if (!inst.getType()->isPointerTy()) {
       return;
     }
 
     auto resultPtrValue = static_cast<const llvm::Value *>(&inst);
     auto sourcePtrValue = inst.getPointerOperand();
-    auto resultPtrNode = solver.GetValueTree()->GetValueNode(resultPtrValue);
-    auto sourcePtrNode = solver.GetValueTree()->GetValueNode(sourcePtrValue);
+    // Loads through constants without a value tree, such as null pointers, load nothing.
+    auto resultPtrNode = gatherer.GetValueTree()->GetValueNode(resultPtrValue);
+    auto sourcePtrNode = gatherer.GetValueTree()->GetValueNode(sourcePtrValue);
+    if (!sourcePtrNode) {
+      return;
+    }
 
     assert(resultPtrNode->isPointer());
     assert(sourcePtrNode->isPointer());
 
-    resultPtrNode->pointer()->AssignedPointee(sourcePtrNode->pointer());
+    gatherer.GetConstraintGraph().AddAssignedPointee(resultPtrNode->pointer(), sourcePtrNode->pointer());
   }
 };
 
 template <>
 struct PointerInstructionHandler<llvm::PHINode> {
-  static void Handle(PointsToSolver &solver, const llvm::PHINode &phi) noexcept {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::PHINode &phi) noexcept {
     if (!phi.getType()->isPointerTy()) {
       return;
     }
 
     auto resultPtrValue = static_cast<const llvm::Value *>(&phi);
-    auto resultPtrNode = solver.GetValueTree()->GetValueNode(resultPtrValue);
+    auto resultPtrNode = gatherer.GetValueTree()->GetValueNode(resultPtrValue);
     assert(resultPtrNode->isPointer());
 
+    // Incoming constants without a value tree, such as null pointers, point to nothing.
     for (const auto &sourcePtrValueUse : phi.incoming_values()) {
       auto sourcePtrValue = sourcePtrValueUse.get();
-      auto sourcePtrNode = solver.GetValueTree()->GetValueNode(sourcePtrValue);
+      auto sourcePtrNode = gatherer.GetValueTree()->GetValueNode(sourcePtrValue);
+      if (!sourcePtrNode) {
+        continue;
+      }
       assert(sourcePtrNode->isPointer());
 
-      resultPtrNode->pointer()->AssignedPointer(sourcePtrNode->pointer());
+      gatherer.GetConstraintGraph().AddAssignedPointer(resultPtrNode->pointer(), sourcePtrNode->pointer());
     }
   }
 };
 
 template <>
 struct PointerInstructionHandler<llvm::ReturnInst> {
-  static void Handle(PointsToSolver &solver, const llvm::ReturnInst &inst) noexcept {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::ReturnInst &inst) noexcept {
     auto returnValue = inst.getReturnValue();
-    if (!returnValue->getType()->isPointerTy()) {
+    if (!returnValue || !returnValue->getType()->isPointerTy()) {
       return;
     }
 
+    // Returned constants without a value tree, such as null pointers, point to nothing.
     auto function = inst.getFunction();
-    auto returnValueNode = solver.GetValueTree()->GetValueNode(returnValue);
-    auto functionReturnValueNode = solver.GetValueTree()->GetFunctionReturnValueNode(function);
+    auto returnValueNode = gatherer.GetValueTree()->GetValueNode(returnValue);
+    if (!returnValueNode) {
+      return;
+    }
+    auto functionReturnValueNode = gatherer.GetValueTree()->GetFunctionReturnValueNode(function);
     assert(returnValueNode->isPointer());
     assert(functionReturnValueNode->isPointer());
 
-    functionReturnValueNode->pointer()->AssignedPointer(returnValueNode->pointer());
+    gatherer.GetConstraintGraph().AddAssignedPointer(functionReturnValueNode->pointer(), returnValueNode->pointer());
   }
 };
 
 template <>
 struct PointerInstructionHandler<llvm::SelectInst> {
-  static void Handle(PointsToSolver &solver, const llvm::SelectInst &inst) noexcept {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::SelectInst &inst) noexcept {
     if (!inst.getType()->isPointerTy()) {
       return;
     }
 
     auto resultPtrValue = static_cast<const llvm::Value *>(&inst);
-    auto resultPtrNode = solver.GetValueTree()->GetValueNode(resultPtrValue);
+    auto resultPtrNode = gatherer.GetValueTree()->GetValueNode(resultPtrValue);
     assert(resultPtrNode->isPointer());
 
     const llvm::Value *sourcePtrValues[2] = {
         inst.getTrueValue(),
         inst.getFalseValue()
     };
+    // Selected constants without a value tree, such as null pointers, point to nothing.
     for (auto sourcePtrValue : sourcePtrValues) {
-      auto sourcePtrNode = solver.GetValueTree()->GetValueNode(sourcePtrValue);
+      auto sourcePtrNode = gatherer.GetValueTree()->GetValueNode(sourcePtrValue);
+      if (!sourcePtrNode) {
+        continue;
+      }
       assert(sourcePtrNode->isPointer());
 
-      resultPtrNode->pointer()->AssignedPointer(sourcePtrNode->pointer());
+      gatherer.GetConstraintGraph().AddAssignedPointer(resultPtrNode->pointer(), sourcePtrNode->pointer());
     }
   }
 };
 
 template <>
 struct PointerInstructionHandler<llvm::StoreInst> {
-  static void Handle(PointsToSolver &solver, const llvm::StoreInst &inst) noexcept {
-    auto targetPtrValue = inst.getPointerOperand();
-    //if (!targetPtrValue->getType()->getPointerElementType()->isPointerTy()) {
-    if (!targetPtrValue->getType()->isPointerTy()) {
+  static void Handle(ConstraintGatherer &gatherer, const llvm::StoreInst &inst) noexcept {
+    auto sourcePtrValue = inst.getValueOperand();
+    if (!sourcePtrValue->getType()->isPointerTy()) {
       return;
     }
 
-    auto sourcePtrValue = inst.getValueOperand();
-
-    auto targetPtrNode = solver.GetValueTree()->GetValueNode(targetPtrValue);
-    auto sourcePtrNode = solver.GetValueTree()->GetValueNode(sourcePtrValue);
+    // Stored constants without a value tree, such as null pointers, point to nothing.
+    auto targetPtrValue = inst.getPointerOperand();
+    auto targetPtrNode = gatherer.GetValueTree()->GetValueNode(targetPtrValue);
+    auto sourcePtrNode = gatherer.GetValueTree()->GetValueNode(sourcePtrValue);
+    if (!targetPtrNode || !sourcePtrNode) {
+      return;
+    }
     assert(targetPtrNode->isPointer());
     assert(sourcePtrNode->isPointer());
 
-    targetPtrNode->pointer()->PointeeAssigned(sourcePtrNode->pointer());
+    gatherer.GetConstraintGraph().AddPointeeAssigned(targetPtrNode->pointer(), sourcePtrNode->pointer());
   }
 };
 
@@ -219,16 +355,17 @@ struct PointerInstructionHandler<llvm::StoreInst> {
   H(CallInst)                     \
   H(ExtractValueInst)             \
   H(GetElementPtrInst)            \
+  H(InvokeInst)                   \
   H(LoadInst)                     \
   H(PHINode)                      \
   H(ReturnInst)                   \
   H(SelectInst)                   \
   H(StoreInst)
 
-void UpdateAndersonSolverOnInst(PointsToSolver &solver, const llvm::Instruction &inst) noexcept {
+void GatherConstraintsOnInst(ConstraintGatherer &gatherer, const llvm::Instruction &inst) noexcept {
 #define INST_DISPATCHER(instType)                                                                 \
   if (llvm::isa<llvm::instType>(inst)) {                                                          \
-    PointerInstructionHandler<llvm::instType>::Handle(solver, llvm::cast<llvm::instType>(inst));  \
+    PointerInstructionHandler<llvm::instType>::Handle(gatherer, llvm::cast<llvm::instType>(inst));  \
   }
 LLVM_POINTER_INST_LIST(INST_DISPATCHER)
 #undef INST_DISPATCHER
@@ -236,26 +373,239 @@ LLVM_POINTER_INST_LIST(INST_DISPATCHER)
 
 #undef LLVM_POINTER_INST_LIST
 
-} // namespace <anonymous>
-
-char AndersonPointsToAnalysis::ID = 0;
+ValueTreeOptions GetValueTreeOptions() noexcept {
+  ValueTreeOptions options;
+  options.smashArrays = SmashArraysOption;
+  options.maxArrayElements = MaxArrayElementsOption;
+  options.maxFieldDepth = MaxFieldDepthOption;
+  return options;
+}
 
-bool AndersonPointsToAnalysis::runOnModule(llvm::Module &module) {
-  PointsToSolver solver { module };
+void AnalyzeModule(llvm::Module &module, std::unique_ptr<ValueTree> &valueTree,
+                   std::unique_ptr<PointsToSolver> &solverOwner) noexcept {
+  auto options = GetValueTreeOptions();
+  auto solver = CreateAndersonSolver(module);
+
+  // Incremental updates need the state of the solver, which a snapshot does not have.
+  auto useSnapshot = !SnapshotOption.empty() && !solver->isIncremental();
+  PointsToSnapshot::ModuleHash moduleHash;
+  if (useSnapshot) {
+    moduleHash = PointsToSnapshot::ComputeModuleHash(module);
+    auto snapshot = PointsToSnapshot::Open(SnapshotOption, moduleHash, options);
+    if (snapshot && snapshot->Apply(*solver->GetValueTree())) {
+      valueTree = solver->TakeValueTree();
+      solverOwner = nullptr;
+      return;
+    }
+  }
 
+  std::vector<const llvm::Function *> functions;
   for (const auto &func : module) {
+    functions.push_back(&func);
+  }
+  UpdateAndersonSolverOnFunctions(*solver, functions);
+  solver->Solve();
+
+  WriteAndersonStatistics(*solver);
+
+  // Widened pointee sets depend on the budget, so they are not saved for later runs which may have a larger one.
+  useSnapshot = useSnapshot && !solver->isBudgetExceeded();
+  if (solver->isIncremental()) {
+    valueTree = nullptr;
+    solverOwner = std::move(solver);
+  } else {
+    valueTree = solver->TakeValueTree();
+    solverOwner = nullptr;
+  }
+
+  if (useSnapshot) {
+    PointsToSnapshot::Write(*valueTree, moduleHash, options, SnapshotOption);
+  }
+}
+
+} // namespace <anonymous>
+
+std::unique_ptr<PointsToSolver> CreateAndersonSolver(const llvm::Module &module) noexcept {
+  auto solver = std::make_unique<PointsToSolver>(module, GetValueTreeOptions(), NumThreadsOption);
+  solver->SetPointeeSetRepresentation(PointeeSetRepresentationOption);
+  solver->SetOfflineEquivalence(OfflineEquivalenceOption);
+  solver->SetIncremental(IncrementalOption);
+  solver->SetCollectStatistics(!StatisticsOption.empty());
+
+  PointsToSolver::Budget budget;
+  budget.milliseconds = TimeBudgetOption;
+  budget.pops = PopBudgetOption;
+  budget.megabytes = MemoryBudgetOption;
+  solver->SetBudget(budget);
+  return solver;
+}
+
+void UpdateAndersonSolverOnFunctions(PointsToSolver &solver,
+                                     llvm::ArrayRef<const llvm::Function *> functions) noexcept {
+  solver.GatherFunctions(functions, [](ConstraintGatherer &gatherer, const llvm::Function &func) noexcept {
     for (const auto &bb : func) {
       for (const auto &inst : bb) {
-        UpdateAndersonSolverOnInst(solver, inst);
+        GatherConstraintsOnInst(gatherer, inst);
       }
     }
+  });
+}
+
+void WriteAndersonStatistics(const PointsToSolver &solver) noexcept {
+  if (StatisticsOption.empty()) {
+    return;
+  }
+  std::error_code error;
+  llvm::raw_fd_ostream os { StatisticsOption, error };
+  if (!error) {
+    solver.WriteStatistics(os);
   }
-  solver.Solve();
+}
+
+char AndersonPointsToAnalysis::ID = 0;
+
+AndersonPointsToAnalysis::AndersonPointsToAnalysis() noexcept
+  : llvm::ModulePass { ID },
+    _valueTree(nullptr),
+    _solver(nullptr)
+{ }
 
-  _valueTree = solver.TakeValueTree();
+AndersonPointsToAnalysis::~AndersonPointsToAnalysis() noexcept = default;
+
+bool AndersonPointsToAnalysis::runOnModule(llvm::Module &module) {
+  AnalyzeModule(module, _valueTree, _solver);
   return false;  // The module is not modified by this pass.
 }
 
+bool AndersonPointsToAnalysis::UpdateFunctions(llvm::Module &module,
+                                               llvm::ArrayRef<const llvm::Function *> changedFunctions) noexcept {
+  std::vector<const llvm::Function *> functions;
+  if (_solver && _solver->BeginUpdate(changedFunctions, functions)) {
+    UpdateAndersonSolverOnFunctions(*_solver, functions);
+    if (_solver->Update()) {
+      return true;
+    }
+  }
+
+  _solver = nullptr;
+  runOnModule(module);
+  return false;
+}
+
+ValueTree* AndersonPointsToAnalysis::GetValueTree() const noexcept {
+  assert((_valueTree || _solver) && "The analysis has not been run");
+  return _solver ? _solver->GetValueTree() : _valueTree.get();
+}
+
+AndersonResult::AndersonResult(std::unique_ptr<ValueTree> valueTree, std::unique_ptr<PointsToSolver> solver) noexcept
+  : _valueTree(std::move(valueTree)),
+    _solver(std::move(solver)),
+    _aliasCache(),
+    _reachableCache()
+{ }
+
+AndersonResult::AndersonResult(AndersonResult &&another) noexcept = default;
+
+AndersonResult::~AndersonResult() noexcept = default;
+
+bool AndersonResult::invalidate(llvm::Module &, const llvm::PreservedAnalyses &preserved,
+                                llvm::ModuleAnalysisManager::Invalidator &) noexcept {
+  auto checker = preserved.getChecker<AndersonAnalysis>();
+  return !checker.preserved() && !checker.preservedSet<llvm::AllAnalysesOn<llvm::Module>>();
+}
+
+ValueTree* AndersonResult::GetValueTree() const noexcept {
+  return _solver ? _solver->GetValueTree() : _valueTree.get();
+}
+
+const PointeeSet* AndersonResult::GetPointeeSet(const llvm::Value *value) const noexcept {
+  auto node = GetValueTree()->GetValueNode(value);
+  if (!node || !node->isPointer()) {
+    return nullptr;
+  }
+  return &node->pointer()->GetPointeeSet();
+}
+
+bool AndersonResult::isWidened(const llvm::Value *value) const noexcept {
+  auto node = GetValueTree()->GetValueNode(value);
+  return node && node->isPointer() && node->pointer()->isWidened();
+}
+
+bool AndersonResult::MayAlias(const llvm::Value *lhs, const llvm::Value *rhs) const noexcept {
+  auto lhsPointees = GetPointeeSet(lhs);
+  auto rhsPointees = GetPointeeSet(rhs);
+  if (!lhsPointees || !rhsPointees) {
+    return true;
+  }
+  if (lhsPointees == rhsPointees) {
+    return !lhsPointees->empty();
+  }
+
+  // Interned sets are equal exactly when they are the same object, so the pair of sets identifies the query.
+  auto key = std::less<const PointeeSet *> { }(lhsPointees, rhsPointees)
+      ? std::make_pair(lhsPointees, rhsPointees)
+      : std::make_pair(rhsPointees, lhsPointees);
+  auto result = _aliasCache.try_emplace(key, false);
+  if (result.second) {
+    result.first->second = lhsPointees->intersects(*rhsPointees);
+  }
+  return result.first->second;
+}
+
+const PointeeSet* AndersonResult::GetReachableObjects(const llvm::Value *value) const noexcept {
+  auto pointees = GetPointeeSet(value);
+  if (!pointees) {
+    return nullptr;
+  }
+  auto it = _reachableCache.find(pointees);
+  if (it != _reachableCache.end()) {
+    return it->second;
+  }
+
+  // A breadth-first search over the pointers stored anywhere within the reachable objects.
+  auto valueTree = GetValueTree();
+  PointeeSet reachable { &valueTree->GetPointeeTable() };
+  std::vector<const Pointee *> worklist;
+  auto reach = [&reachable, &worklist](const PointeeSet &objects) noexcept {
+    for (auto object : objects) {
+      if (reachable.insert(const_cast<Pointee *>(object))) {
+        worklist.push_back(object);
+      }
+    }
+  };
+  reach(*pointees);
+
+  std::vector<const ValueTreeNode *> nodes;
+  while (!worklist.empty()) {
+    auto object = worklist.back();
+    worklist.pop_back();
+    nodes.assign(1, object->node());
+    while (!nodes.empty()) {
+      auto node = nodes.back();
+      nodes.pop_back();
+      if (node->isPointer()) {
+        reach(node->pointer()->GetPointeeSet());
+      }
+      for (size_t i = 0; i < node->GetNumChildren(); ++i) {
+        nodes.push_back(node->GetChild(i));
+      }
+    }
+  }
+
+  auto result = valueTree->GetPointeeSetPool().Intern(std::move(reachable));
+  _reachableCache.try_emplace(pointees, result);
+  return result;
+}
+
+llvm::AnalysisKey AndersonAnalysis::Key;
+
+AndersonAnalysis::Result AndersonAnalysis::run(llvm::Module &module, llvm::ModuleAnalysisManager &) noexcept {
+  std::unique_ptr<ValueTree> valueTree;
+  std::unique_ptr<PointsToSolver> solver;
+  AnalyzeModule(module, valueTree, solver);
+  return Result { std::move(valueTree), std::move(solver) };
+}
+
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCUnusedGlobalDeclarationInspection"
 static llvm::RegisterPass<AndersonPointsToAnalysis> RegisterAnderson { // NOLINT(cert-err58-cpp)
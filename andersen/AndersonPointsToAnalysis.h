@@ -5,22 +5,31 @@
 #define LLVM_ANDERSON_POINTS_TO_ANALYSIS_H
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstddef>
+#include <deque>
 #include <functional>
 #include <iterator>
 #include <memory>
-#include <unordered_map>
+#include <type_traits>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/SparseBitVector.h>
 #include <llvm/ADT/iterator_range.h>
+#include <llvm/Support/Allocator.h>
 #include <llvm/IR/Argument.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 #include <llvm/Pass.h>
@@ -49,6 +58,7 @@ struct PolymorphicHasher {
 
 class Pointee;
 class Pointer;
+class PointsToSolver;
 class ValueTreeNode;
 
 /**
@@ -77,131 +87,18 @@ enum class PointerAssignmentKind {
    * Pointer assignment statement of the form `*p = q`.
    */
   PointeeAssigned,
-};
-
-/**
- * Base class of pointer assignment statements.
- */
-class PointerAssignment {
-public:
-  virtual ~PointerAssignment() noexcept = default;
 
   /**
-   * Get the kind of this pointer assignment statement.
-   *
-   * @return the kind of this pointer assignment statement.
+   * Pointer assignment statement of the form `p = (*q)(...)`, i.e. `p` receives the return values of the functions
+   * pointed to by `q`.
    */
-  PointerAssignmentKind kind() const noexcept { return _kind; }
-
-  /**
-   * Get the hash code of this PointerAssignment object.
-   *
-   * @return the hash code of this PointerAssignment object.
-   */
-  virtual size_t GetHashCode() const noexcept {
-    return std::hash<int> { }(static_cast<int>(_kind));
-  }
-
-  virtual bool operator==(const PointerAssignment &rhs) const noexcept {
-    return _kind == rhs._kind;
-  }
+  AssignedReturnValue,
 
-  virtual bool operator!=(const PointerAssignment &rhs) const noexcept {
-    return !operator==(rhs);
-  }
-
-protected:
   /**
-   * Construct a new PointerAssignment object.
-   *
-   * @param kind kind of the pointer assignment statement.
+   * Pointer assignment statement of the form `(*p)(..., q, ...)`, i.e. the parameter at some argument position of the
+   * functions pointed to by `p` receives `q`.
    */
-  explicit PointerAssignment(PointerAssignmentKind kind) noexcept
-    : _kind(kind)
-  { }
-
-private:
-  PointerAssignmentKind _kind;
-};
-
-/**
- * Pointer assignment statements of the form `p = &q`.
- */
-class PointerAssignedAddressOf : public PointerAssignment {
-public:
-  static bool classof(const PointerAssignment *obj) noexcept {
-    return obj->kind() == PointerAssignmentKind::AssignedAddressOf;
-  }
-
-  /**
-   * Construct a new PointerAssignedAddressOf object.
-   *
-   * @param pointee the pointee.
-   */
-  explicit PointerAssignedAddressOf(Pointee *pointee) noexcept
-    : PointerAssignment { PointerAssignmentKind::AssignedAddressOf },
-      _pointee(pointee)
-  { }
-
-  /**
-   * Get the pointee.
-   *
-   * @return the pointee.
-   */
-  Pointee* pointee() const noexcept {
-    return _pointee;
-  }
-
-private:
-  Pointee *_pointee;
-};
-
-/**
- * Abstract base class for pointer assignment whose right hand side operand is a pointer.
- */
-class PointerAssignedPointerBase : public PointerAssignment {
-public:
-  static bool classof(const PointerAssignment *obj) noexcept {
-    return obj->kind() == PointerAssignmentKind::AssignedElementPtr ||
-      obj->kind() == PointerAssignmentKind::AssignedPointee ||
-      obj->kind() == PointerAssignmentKind::PointeeAssigned;
-  }
-
-  /**
-   * Get the pointer operand on the right hand side of this pointer assignment statement.
-   *
-   * @return the pointer operand on the right hand side of this pointer assignment statement.
-   */
-  Pointer* pointer() const noexcept { return _pointer; }
-
-  size_t GetHashCode() const noexcept override {
-    return std::hash<uintptr_t> { }(reinterpret_cast<uintptr_t>(_pointer) | static_cast<uintptr_t>(kind()));
-  }
-
-  bool operator==(const PointerAssignment &rhs) const noexcept override {
-    if (kind() != rhs.kind()) {
-      return false;
-    }
-    auto casted = llvm::cast<PointerAssignedPointerBase>(rhs);
-    return _pointer == casted._pointer;
-  }
-
-protected:
-  /**
-   * Construct a new PointerAssignedPointerBase object.
-   *
-   * @param kind the pointer assignment kind.
-   * @param pointer the pointer operand on the right hand side of this pointer assignment statement.
-   */
-  explicit PointerAssignedPointerBase(PointerAssignmentKind kind, Pointer *pointer) noexcept
-    : PointerAssignment { kind },
-      _pointer(pointer)
-  {
-    assert(pointer && "pointer cannot be null");
-  }
-
-private:
-  Pointer *_pointer;
+  ArgumentAssigned,
 };
 
 /**
@@ -260,216 +157,396 @@ public:
     return _index != rhs._index;
   }
 
+  friend llvm::hash_code hash_value(const PointerIndex &index) noexcept {
+    return llvm::hash_value(index._index);
+  }
+
 private:
   size_t _index;
 };
 
 /**
- * Represents a pointer assignment statement of the form `p = &q[...]`.
+ * A sequence of pointer indexes interned by an IndexSequenceTable.
+ *
+ * Sequences interned by the same table are equal if and only if their IDs are equal.
  */
-class PointerAssignedElementPtr : public PointerAssignedPointerBase {
+class IndexSequence {
 public:
-  static bool classof(const PointerAssignment *obj) noexcept {
-    return obj->kind() == PointerAssignmentKind::AssignedElementPtr;
-  }
-
   /**
-   * Construct a new PointerAssignedElementPtr object.
+   * Construct a new IndexSequence object.
    *
-   * @param pointer the pointer operand on the right hand side of the pointer assignment statement.
-   * @param indexSequence the sequence of pointer index.
+   * @param id the ID of the sequence in its table.
+   * @param indexes the pointer indexes, which must outlive this object.
    */
-  explicit PointerAssignedElementPtr(Pointer *pointer, std::vector<PointerIndex> indexSequence) noexcept
-    : PointerAssignedPointerBase { PointerAssignmentKind::AssignedElementPtr, pointer },
-      _indexSequence(std::move(indexSequence))
+  explicit IndexSequence(unsigned id, llvm::ArrayRef<PointerIndex> indexes) noexcept
+    : _id(id),
+      _indexes(indexes)
   { }
 
   /**
-   * Get an iterator range that contains the sequence of pointer indexes in this pointer assignment statement.
+   * Get the sequence `{ 0 }`, which is the index sequence of a trivial pointer assignment `p = q`. The sequence has the
+   * same ID in every IndexSequenceTable.
    *
-   * @return an iterator range that contains the sequence of pointer indexes in this pointer assignment statement.
+   * @return the sequence `{ 0 }`.
    */
-  llvm::iterator_range<typename std::vector<PointerIndex>::const_iterator> index_sequence() const noexcept {
-    return llvm::iterator_range<typename std::vector<PointerIndex>::const_iterator> {
-      _indexSequence.cbegin(),
-      _indexSequence.cend()
-    };
-  }
+  static IndexSequence Trivial() noexcept;
 
   /**
-   * Determine whether this pointer assignment is a trivial assignment, which has the form of `p = q`.
+   * Get the ID of this sequence in its table.
    *
-   * @return whether this pointer assignment is a trivial assignment.
+   * @return the ID of this sequence in its table.
    */
-  bool isTrivialAssignment() const noexcept {
-    if (_indexSequence.empty()) {
-      return true;
-    }
-    return _indexSequence.size() == 1 && _indexSequence[0].index() == 0;
-  }
-
-  size_t GetHashCode() const noexcept final;
+  unsigned id() const noexcept { return _id; }
 
-  bool operator==(const PointerAssignment &rhs) const noexcept final;
+  /**
+   * Get the pointer indexes in this sequence.
+   *
+   * @return the pointer indexes in this sequence.
+   */
+  llvm::ArrayRef<PointerIndex> indexes() const noexcept { return _indexes; }
 
 private:
-  std::vector<PointerIndex> _indexSequence;
+  unsigned _id;
+  llvm::ArrayRef<PointerIndex> _indexes;
 };
 
 /**
- * Represent a pointer assignment statement of the form `p = *q`.
+ * A table in which every distinct sequence of pointer indexes is stored once and identified by a dense ID.
  */
-class PointerAssignedPointee : public PointerAssignedPointerBase {
+class IndexSequenceTable {
 public:
-  static bool classof(const PointerAssignment *obj) noexcept {
-    return obj->kind() == PointerAssignmentKind::AssignedPointee;
+  /**
+   * The ID of the sequence `{ 0 }`, which is interned by every table on construction.
+   */
+  constexpr static const unsigned TrivialSequenceId = 0;
+
+  /**
+   * Construct a new IndexSequenceTable object.
+   */
+  explicit IndexSequenceTable() noexcept;
+
+  NON_COPIABLE_NON_MOVABLE(IndexSequenceTable)
+
+  /**
+   * Get the number of distinct sequences in this table.
+   *
+   * @return the number of distinct sequences in this table.
+   */
+  size_t size() const noexcept {
+    return _sequences.size();
   }
 
   /**
-   * Construct a new PointerAssignedPointee object.
+   * Get the interned sequence that is equal to the specified pointer indexes, interning a copy of them if no such
+   * sequence exists yet. The empty sequence is equivalent to `{ 0 }` and is interned as the trivial sequence.
    *
-   * @param pointer the pointer operand on the right hand side of the pointer assignment statement.
+   * @param indexes the pointer indexes.
+   * @return the interned sequence.
    */
-  explicit PointerAssignedPointee(Pointer *pointer) noexcept
-    : PointerAssignedPointerBase { PointerAssignmentKind::AssignedPointee, pointer }
-  { }
+  IndexSequence Intern(llvm::ArrayRef<PointerIndex> indexes) noexcept;
+
+  /**
+   * Get the interned sequence with the specified ID.
+   *
+   * @param id the ID of the sequence.
+   * @return the interned sequence with the specified ID.
+   */
+  IndexSequence Get(unsigned id) const noexcept {
+    assert(id < _sequences.size() && "invalid index sequence ID");
+    return IndexSequence { id, _sequences[id] };
+  }
+
+private:
+  std::deque<std::vector<PointerIndex>> _sequences;
+  llvm::DenseMap<llvm::ArrayRef<PointerIndex>, unsigned> _ids;
 };
 
 /**
- * Represent a pointer assignment statement of the form `*p = q`.
+ * Representations of pointee sets.
  */
-class PointeeAssignedPointer : public PointerAssignedPointerBase {
+enum class PointeeSetRepresentation {
+  /**
+   * Pointee IDs are kept in a sorted vector. This is the most compact representation for small sets.
+   */
+  SortedVector,
+
+  /**
+   * Pointee IDs are kept in a sparse bitvector, so that merging two sets is a word-wise OR.
+   */
+  SparseBitVector,
+
+  /**
+   * Sets start as sorted vectors and switch to sparse bitvectors once they grow beyond
+   * `PointeeTable::AdaptiveThreshold` elements.
+   */
+  Adaptive,
+};
+
+/**
+ * Map dense pointee IDs to the corresponding Pointee objects.
+ *
+ * Every ValueTree owns a PointeeTable that numbers all of its pointees. Pointee sets store pointee IDs and refer to the
+ * table to resolve them. The table also decides the representation of the pointee sets that refer to it.
+ */
+class PointeeTable {
 public:
-  static bool classof(const PointerAssignment *obj) noexcept {
-    return obj->kind() == PointerAssignmentKind::PointeeAssigned;
+  /**
+   * The maximal number of elements held by a sorted vector under the `PointeeSetRepresentation::Adaptive`
+   * representation.
+   */
+  constexpr static const size_t AdaptiveThreshold = 128;
+
+  /**
+   * Construct a new PointeeTable object.
+   */
+  explicit PointeeTable() noexcept
+    : _pointees(),
+      _representation(PointeeSetRepresentation::Adaptive)
+  { }
+
+  NON_COPIABLE_NON_MOVABLE(PointeeTable)
+
+  /**
+   * Get the number of pointees in this table.
+   *
+   * @return the number of pointees in this table.
+   */
+  size_t size() const noexcept {
+    return _pointees.size();
   }
 
   /**
-   * Construct a new PointeeAssignedPointer object.
+   * Reserve space for the specified number of pointees.
    *
-   * @param pointer the pointer operand on the right hand side of the pointer assignment statement.
+   * @param size the number of pointees.
    */
-  explicit PointeeAssignedPointer(Pointer *pointer) noexcept
-    : PointerAssignedPointerBase { PointerAssignmentKind::PointeeAssigned, pointer }
-  { }
+  void reserve(size_t size) noexcept {
+    _pointees.reserve(size);
+  }
+
+  /**
+   * Add the specified pointee into this table.
+   *
+   * @param pointee the pointee.
+   * @return the ID of the pointee.
+   */
+  size_t AddPointee(Pointee *pointee) noexcept {
+    assert(pointee && "pointee cannot be null");
+    _pointees.push_back(pointee);
+    return _pointees.size() - 1;
+  }
+
+  /**
+   * Get the pointee with the specified ID.
+   *
+   * @param id the pointee ID.
+   * @return the pointee with the specified ID.
+   */
+  Pointee* GetPointee(size_t id) const noexcept {
+    assert(id < _pointees.size() && "id is out of range");
+    return _pointees[id];
+  }
+
+  /**
+   * Get the representation of the pointee sets that refer to this table.
+   *
+   * @return the representation of the pointee sets that refer to this table.
+   */
+  PointeeSetRepresentation representation() const noexcept {
+    return _representation;
+  }
+
+  /**
+   * Set the representation of the pointee sets that refer to this table.
+   *
+   * The representation only affects pointee sets that grow afterwards, so it should be set before the pointee sets are
+   * populated.
+   *
+   * @param representation the representation.
+   */
+  void SetRepresentation(PointeeSetRepresentation representation) noexcept {
+    _representation = representation;
+  }
+
+  /**
+   * Get the number of elements beyond which a pointee set switches to the sparse bitvector representation.
+   *
+   * @return the number of elements beyond which a pointee set switches to the sparse bitvector representation.
+   */
+  size_t GetBitVectorThreshold() const noexcept {
+    switch (_representation) {
+      case PointeeSetRepresentation::SortedVector:
+        return static_cast<size_t>(-1);
+      case PointeeSetRepresentation::SparseBitVector:
+        return 0;
+      case PointeeSetRepresentation::Adaptive:
+      default:
+        return AdaptiveThreshold;
+    }
+  }
+
+private:
+  std::vector<Pointee *> _pointees;
+  PointeeSetRepresentation _representation;
 };
 
 /**
- * A set of GetPointeeSet.
+ * A set of pointees.
+ *
+ * Elements are stored as dense pointee IDs, either in a sorted vector or in a sparse bitvector, as decided by the
+ * PointeeTable the set refers to. Elements are always enumerated in ascending order of their IDs.
  */
 class PointeeSet {
-public:
-  class const_iterator;
+  using BitVector = llvm::SparseBitVector<>;
 
+public:
   /**
    * Iterator of PointeeSet.
+   *
+   * @tparam T either `Pointee` or `const Pointee`.
    */
-  class iterator {
+  template <typename T>
+  class basic_iterator {
   public:
-    /**
-     * Type of the inner iterator.
-     */
-    using inner_iterator = typename std::unordered_set<Pointee *>::iterator;
-
     using difference_type = void;
-    using value_type = Pointee *;
-    using reference = Pointee *;
+    using value_type = T *;
+    using reference = T *;
     using pointer = void;
     using iterator_category = std::input_iterator_tag;
 
     /**
-     * Construct a new iterator object from the given inner iterator.
+     * Construct a new iterator object that enumerates a sorted vector of pointee IDs.
      *
-     * @param inner the inner iterator.
+     * @param table the pointee table.
+     * @param position the current position in the sorted vector.
      */
-    explicit iterator(inner_iterator inner) noexcept
-      : _inner(inner)
+    explicit basic_iterator(const PointeeTable *table, const unsigned *position) noexcept
+      : _table(table),
+        _position(position),
+        _bitPosition()
     { }
 
-    Pointee* operator*() const noexcept {
-      return *_inner;
+    /**
+     * Construct a new iterator object that enumerates a sparse bitvector of pointee IDs.
+     *
+     * @param table the pointee table.
+     * @param bitPosition the current position in the sparse bitvector.
+     */
+    explicit basic_iterator(const PointeeTable *table, BitVector::iterator bitPosition) noexcept
+      : _table(table),
+        _position(nullptr),
+        _bitPosition(bitPosition)
+    { }
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+    basic_iterator(const basic_iterator<U> &iter) noexcept // NOLINT(google-explicit-constructor)
+      : _table(iter._table),
+        _position(iter._position),
+        _bitPosition(iter._bitPosition)
+    { }
+
+    T* operator*() const noexcept {
+      return _table->GetPointee(_position ? *_position : *_bitPosition);
     }
 
-    iterator& operator++() noexcept {
-      ++_inner;
+    basic_iterator& operator++() noexcept {
+      if (_position) {
+        ++_position;
+      } else {
+        ++_bitPosition;
+      }
       return *this;
     }
 
-    iterator operator++(int) & noexcept { // NOLINT(cert-dcl21-cpp)
+    basic_iterator operator++(int) & noexcept { // NOLINT(cert-dcl21-cpp)
       auto old = *this;
-      ++_inner;
+      ++*this;
       return old;
     }
 
-    bool operator==(const iterator &rhs) const noexcept {
-      return _inner == rhs._inner;
+    bool operator==(const basic_iterator &rhs) const noexcept {
+      if (_position || rhs._position) {
+        return _position == rhs._position;
+      }
+      return _bitPosition == rhs._bitPosition;
     }
 
-    bool operator!=(const iterator &rhs) const noexcept {
-      return _inner != rhs._inner;
+    bool operator!=(const basic_iterator &rhs) const noexcept {
+      return !operator==(rhs);
     }
 
-    friend class PointeeSet::const_iterator;
+    template <typename U>
+    friend class basic_iterator;
 
   private:
-    inner_iterator _inner;
+    const PointeeTable *_table;
+    const unsigned *_position;
+    BitVector::iterator _bitPosition;
   };
 
+  using iterator = basic_iterator<Pointee>;
+  using const_iterator = basic_iterator<const Pointee>;
+
   /**
-   * Constant iterator of PointeeSet.
+   * Construct a new PointeeSet object.
+   *
+   * @param table the pointee table that resolves the pointee IDs in this set. A set that does not refer to a table
+   * adopts the table of the first set merged into it.
    */
-  class const_iterator {
-  public:
-    /**
-     * Type of the inner iterator.
-     */
-    using inner_iterator = typename std::unordered_set<Pointee *>::const_iterator;
-
-    using difference_type = void;
-    using value_type = const Pointee *;
-    using reference = const Pointee *;
-    using pointer = void;
-    using iterator_category = std::input_iterator_tag;
-
-    /**
-     * Construct a new const_iterator object from the given inner iterator.
-     *
-     * @param inner the inner iterator.
-     */
-    explicit const_iterator(inner_iterator inner) noexcept
-      : _inner(inner)
-    { }
+  explicit PointeeSet(const PointeeTable *table = nullptr) noexcept
+    : _table(table),
+      _ids(),
+      _bits(),
+      _numBits(0)
+  { }
 
-    const_iterator(iterator iter) noexcept // NOLINT(google-explicit-constructor)
-      : _inner(iter._inner)
-    { }
+  PointeeSet(const PointeeSet &another) noexcept
+    : _table(another._table),
+      _ids(another._ids),
+      _bits(another._bits ? std::make_unique<BitVector>(*another._bits) : nullptr),
+      _numBits(another._numBits)
+  { }
 
-    const Pointee* operator*() const noexcept {
-      return *_inner;
-    }
+  PointeeSet(PointeeSet &&another) noexcept = default;
 
-    const_iterator& operator++() noexcept {
-      ++_inner;
-      return *this;
+  PointeeSet& operator=(const PointeeSet &another) noexcept {
+    if (this != &another) {
+      _table = another._table;
+      _ids = another._ids;
+      _bits = another._bits ? std::make_unique<BitVector>(*another._bits) : nullptr;
+      _numBits = another._numBits;
     }
+    return *this;
+  }
 
-    const_iterator operator++(int) & noexcept { // NOLINT(cert-dcl21-cpp)
-      auto old = *this;
-      ++_inner;
-      return old;
-    }
+  PointeeSet& operator=(PointeeSet &&another) noexcept = default;
 
-    bool operator==(const const_iterator &rhs) const noexcept {
-      return _inner == rhs._inner;
-    }
+  /**
+   * Get the pointee table that resolves the pointee IDs in this set.
+   *
+   * @return the pointee table that resolves the pointee IDs in this set.
+   */
+  const PointeeTable* table() const noexcept {
+    return _table;
+  }
 
-    bool operator!=(const const_iterator &rhs) const noexcept {
-      return _inner != rhs._inner;
-    }
+  /**
+   * Set the pointee table that resolves the pointee IDs in this set.
+   *
+   * @param table the pointee table.
+   */
+  void SetTable(const PointeeTable *table) noexcept {
+    _table = table;
+  }
 
-  private:
-    inner_iterator _inner;
-  };
+  /**
+   * Determine whether this set is represented by a sparse bitvector.
+   *
+   * @return whether this set is represented by a sparse bitvector.
+   */
+  bool isBitVector() const noexcept {
+    return static_cast<bool>(_bits);
+  }
 
   /**
    * Get the number of elements contained in the PointeeSet.
@@ -477,11 +554,20 @@ public:
    * @return the number of elements contained in the PointeeSet.
    */
   size_t size() const noexcept {
-    return _pointees.size();
+    return _bits ? _numBits : _ids.size();
+  }
+
+  /**
+   * Determine whether this set is empty.
+   *
+   * @return whether this set is empty.
+   */
+  bool empty() const noexcept {
+    return _bits ? _bits->empty() : _ids.empty();
   }
 
   iterator begin() noexcept {
-    return iterator { _pointees.begin() };
+    return _bits ? iterator { _table, _bits->begin() } : iterator { _table, _ids.begin() };
   }
 
   const_iterator begin() const noexcept {
@@ -489,27 +575,19 @@ public:
   }
 
   iterator end() noexcept  {
-    return iterator { _pointees.end() };
+    return _bits ? iterator { _table, _bits->end() } : iterator { _table, _ids.end() };
   }
 
   const_iterator end() const noexcept  {
     return cend();
   }
 
-  const_iterator cbegin() noexcept {
-    return const_iterator { _pointees.cbegin() };
-  }
-
   const_iterator cbegin() const noexcept {
-    return const_iterator { _pointees.cbegin() };
-  }
-
-  const_iterator cend() noexcept {
-    return const_iterator { _pointees.cend() };
+    return const_cast<PointeeSet *>(this)->begin();
   }
 
   const_iterator cend() const noexcept {
-    return const_iterator { _pointees.cend() };
+    return const_cast<PointeeSet *>(this)->end();
   }
 
   /**
@@ -518,31 +596,24 @@ public:
    * @param pointee the pointee.
    * @return whether the insertion takes place.
    */
-  bool insert(Pointee *pointee) noexcept {
-    return _pointees.insert(pointee).second;
-  }
+  inline bool insert(Pointee *pointee) noexcept;
 
   /**
-   * Get the iterator to the specified element.
-   *
-   * @param pointee the element to find.
-   * @return the iterator to the specified element. If no such element are contained in this set, returns `end()`.
+   * Remove all elements from this set.
    */
-  iterator find(Pointee *pointee) noexcept {
-    auto inner = _pointees.find(pointee);
-    return iterator { inner };
+  void clear() noexcept {
+    _ids.clear();
+    _bits.reset();
+    _numBits = 0;
   }
 
   /**
-   * Get the iterator to the specified element.
+   * Determine whether `pointee` is in this set.
    *
-   * @param pointee the element to find.
-   * @return the iterator to the specified element. If no such element are contained in this set, returns `end()`.
+   * @param pointee the pointee.
+   * @return whether `pointee` is in this set.
    */
-  const_iterator find(const Pointee *pointee) const noexcept {
-    auto inner = _pointees.find(const_cast<Pointee *>(pointee));
-    return const_iterator { inner };
-  }
+  inline bool contains(const Pointee *pointee) const noexcept;
 
   /**
    * Return 1 if `pointee` is in this set, otherwise return 0.
@@ -550,11 +621,7 @@ public:
    * @return 1 if `pointee` is in this set, otherwise return 0.
    */
   size_t count(const Pointee *pointee) const noexcept {
-    auto it = find(pointee);
-    if (it == end()) {
-      return 0;
-    }
-    return 1;
+    return static_cast<size_t>(contains(pointee));
   }
 
   /**
@@ -563,11 +630,7 @@ public:
    * @param another another pointee set.
    * @return whether the specified set is a subset of this set.
    */
-  bool isSubset(const PointeeSet &another) const noexcept {
-    return std::all_of(another.begin(), another.end(), [this](const Pointee *anotherElement) noexcept {
-      return count(anotherElement) == 1;
-    });
-  }
+  bool isSubset(const PointeeSet &another) const noexcept;
 
   /**
    * Determine whether this set is a subset of the specified set.
@@ -579,21 +642,30 @@ public:
     return another.isSubset(*this);
   }
 
+  /**
+   * Determine whether this set and the specified set have at least one element in common.
+   *
+   * @param another another pointee set.
+   * @return whether the two sets have at least one element in common.
+   */
+  bool intersects(const PointeeSet &another) const noexcept;
+
   /**
    * Merge all elements from the specified set into this set.
    *
    * @param source the source pointee set.
    * @return whether at least one new element is added into this set.
    */
-  bool MergeFrom(const PointeeSet &source) noexcept {
-    auto newElement = false;
-    for (auto sourceElement : source) {
-      if (insert(const_cast<Pointee *>(sourceElement))) {
-        newElement = true;
-      }
-    }
-    return newElement;
-  }
+  bool MergeFrom(const PointeeSet &source) noexcept;
+
+  /**
+   * Merge all elements from the specified set into this set, and record the elements that are new to this set.
+   *
+   * @param source the source pointee set.
+   * @param added the set that receives the elements that are new to this set.
+   * @return whether at least one new element is added into this set.
+   */
+  bool MergeFrom(const PointeeSet &source, PointeeSet &added) noexcept;
 
   /**
    * Merge all elements from this set into the specified set.
@@ -605,21 +677,54 @@ public:
     return target.MergeFrom(*this);
   }
 
-  bool operator==(const PointeeSet &rhs) const noexcept {
-    return _pointees == rhs._pointees;
-  }
+  bool operator==(const PointeeSet &rhs) const noexcept;
 
   bool operator!=(const PointeeSet &rhs) const noexcept {
-    return _pointees != rhs._pointees;
+    return !operator==(rhs);
   }
 
+  /**
+   * Get the hash code of this set. Equal sets have equal hash codes regardless of their representations.
+   *
+   * @return the hash code of this set.
+   */
+  size_t GetHashCode() const noexcept;
+
   PointeeSet& operator+=(const PointeeSet &rhs) noexcept {
     MergeFrom(rhs);
     return *this;
   }
 
 private:
-  std::unordered_set<Pointee *> _pointees;
+  const PointeeTable *_table;
+  llvm::SmallVector<unsigned, 4> _ids;
+  std::unique_ptr<BitVector> _bits;
+
+  /**
+   * The number of elements in `_bits`. Counting the elements of a sparse bitvector takes linear time.
+   */
+  size_t _numBits;
+
+  bool InsertId(unsigned id) noexcept;
+
+  bool ContainsId(unsigned id) const noexcept;
+
+  bool MergeIds(const llvm::SmallVectorImpl<unsigned> &ids) noexcept;
+
+  void ConvertToBitVector() noexcept;
+
+  template <typename Callback>
+  void ForEachId(Callback &&callback) const noexcept {
+    if (_bits) {
+      for (auto id : *_bits) {
+        callback(id);
+      }
+    } else {
+      for (auto id : _ids) {
+        callback(id);
+      }
+    }
+  }
 };
 
 /**
@@ -633,7 +738,8 @@ public:
    * @param node the location of the pointee in the value tree.
    */
   explicit Pointee(ValueTreeNode &node) noexcept
-    : _node(node)
+    : _node(node),
+      _id(0)
   { }
 
   NON_COPIABLE_NON_MOVABLE(Pointee)
@@ -647,6 +753,15 @@ public:
     return &_node;
   }
 
+  /**
+   * Get the dense ID of this pointee within the value tree.
+   *
+   * @return the dense ID of this pointee within the value tree.
+   */
+  size_t id() const noexcept {
+    return _id;
+  }
+
   /**
    * Determine whether this pointee is a pointer.
    *
@@ -684,7 +799,72 @@ public:
   }
 
 private:
+  friend class ValueTree;
+
   ValueTreeNode &_node;
+  size_t _id;
+};
+
+/**
+ * A pool of immutable pointee sets in which every distinct set is stored only once.
+ *
+ * Sets interned by the same pool are equal if and only if their addresses are equal. Interned sets stay valid until the
+ * pool is destroyed. The pool is not thread-safe.
+ */
+class PointeeSetPool {
+public:
+  /**
+   * Construct a new PointeeSetPool object.
+   *
+   * @param table the pointee table that resolves the pointee IDs in the sets of this pool.
+   */
+  explicit PointeeSetPool(const PointeeTable *table) noexcept
+    : _sets(),
+      _unions(),
+      _emptySet(Intern(PointeeSet { table }))
+  { }
+
+  NON_COPIABLE_NON_MOVABLE(PointeeSetPool)
+
+  /**
+   * Get the number of distinct sets in this pool.
+   *
+   * @return the number of distinct sets in this pool.
+   */
+  size_t size() const noexcept {
+    return _sets.size();
+  }
+
+  /**
+   * Get the interned empty set.
+   *
+   * @return the interned empty set.
+   */
+  const PointeeSet* GetEmptySet() const noexcept {
+    return _emptySet;
+  }
+
+  /**
+   * Get the interned set that is equal to the specified set, interning the specified set if no such set exists yet.
+   *
+   * @param set the set.
+   * @return the interned set that is equal to the specified set.
+   */
+  const PointeeSet* Intern(PointeeSet set) noexcept;
+
+  /**
+   * Get the interned union of two interned sets. Results are memoized.
+   *
+   * @param lhs the first set. It must have been interned by this pool.
+   * @param rhs the second set. It must have been interned by this pool.
+   * @return the interned union of the two sets.
+   */
+  const PointeeSet* Union(const PointeeSet *lhs, const PointeeSet *rhs) noexcept;
+
+private:
+  std::unordered_set<PointeeSet, details::PolymorphicHasher<PointeeSet>> _sets;
+  llvm::DenseMap<std::pair<const PointeeSet *, const PointeeSet *>, const PointeeSet *> _unions;
+  const PointeeSet *_emptySet;
 };
 
 /**
@@ -703,202 +883,372 @@ public:
    */
   explicit Pointer(ValueTreeNode &node) noexcept
     : Pointee { node },
-      _assignedElementPtr(),
-      _assignedPointee(),
-      _pointeeAssigned(),
-      _pointees()
+      _pointees(),
+      _widened(false)
   { }
 
   NON_COPIABLE_NON_MOVABLE(Pointer)
 
   /**
-   * Specify that this pointer is assigned to the address of the specified pointee in the program.
+   * Get the pointee set of this pointer.
    *
-   * @param pointee the pointee.
-   * @return whether the specified constraint is fresh and has been added to the constraints list.
+   * Pointee sets are interned by the PointeeSetPool of the value tree, so pointers with equal pointee sets share the
+   * same set object and two pointee sets can be compared by their addresses.
+   *
+   * @return the pointee set of this pointer.
    */
-  bool AssignedAddressOf(Pointee *pointee) noexcept {
-    assert(pointee && "pointee cannot be null");
-    return _assignedAddressOf.emplace(pointee).second;
+  const PointeeSet& GetPointeeSet() const noexcept {
+    assert(_pointees && "the pointee set has not been set");
+    return *_pointees;
   }
 
   /**
-   * Specify that this pointer is assigned to the specified pointer somewhere in the program.
+   * Set the pointee set of this pointer.
    *
-   * @param pointer the pointer on the right hand side of the pointer assignment.
-   * @return whether the specified constraint is fresh and has been added to the constraints list.
+   * @param pointees the pointee set, which must have been interned by the PointeeSetPool of the value tree.
    */
-  bool AssignedPointer(Pointer *pointer) noexcept {
-    return AssignedElementPtr(pointer, { PointerIndex { 0 } });
+  void SetPointeeSet(const PointeeSet *pointees) noexcept {
+    assert(pointees && "pointees cannot be null");
+    _pointees = pointees;
   }
 
   /**
-   * Specify that this pointer is assigned to the address of some element in the pointee of the specified pointer, with
-   * the specified pointer index sequence.
+   * Determine whether the pointee set of this pointer has been widened because the solver ran out of its budget before
+   * the pointer converged. A widened pointee set is sound but may be much larger than the precise one.
    *
-   * @param pointer the pointer on the right hand side of the pointer assignment.
-   * @param indexSequence the pointer index sequence.
-   * @return whether the specified constraint is fresh and has been added to the constraints list.
+   * @return whether the pointee set of this pointer has been widened.
    */
-  bool AssignedElementPtr(Pointer *pointer, std::vector<PointerIndex> indexSequence) noexcept {
-    assert(pointer && "pointer cannot be null");
-    return _assignedElementPtr.emplace(pointer, std::move(indexSequence)).second;
+  bool isWidened() const noexcept {
+    return _widened;
   }
 
   /**
-   * Specify that this pointer is assigned to the pointee of the specified pointer.
-   *
-   * @param pointer the pointer on the right hand side of the pointer assignment.
-   * @return whether the specified constraint is fresh and has been added to the constraints list.
+   * Mark the pointee set of this pointer as widened.
    */
-  bool AssignedPointee(Pointer *pointer) noexcept {
-    assert(pointer && "pointer cannot be null");
-    return _assignedPointee.emplace(pointer).second;
+  void SetWidened() noexcept {
+    _widened = true;
   }
 
+private:
+  const PointeeSet *_pointees;
+  bool _widened;
+};
+
+/**
+ * A compact identity of a constraint. Two constraints are identical if and only if their keys are equal.
+ */
+struct ConstraintKey {
   /**
-   * Specify that the pointee of this pointer is assigned to the specified pointer.
-   *
-   * @param pointer the pointer on the right hand side of the pointer assignment.
-   * @return whether the specified constraint is fresh and has been added to the constraints list.
+   * The kind of the constraint.
    */
-  bool PointeeAssigned(Pointer *pointer) noexcept {
-    assert(pointer && "pointer cannot be null");
-    return _pointeeAssigned.emplace(pointer).second;
+  PointerAssignmentKind kind;
+
+  /**
+   * The pointee ID of the pointer on the left hand side of the constraint.
+   */
+  unsigned pointerId;
+
+  /**
+   * The pointee ID of `o` in `p = &o`, the pointee ID of `q` in `p = *q`, `*p = q` and `p = (*q)(...)`, the ID of the
+   * index sequence in the upper 32 bits and the pointee ID of `q` in the lower 32 bits in `p = &q[...]`, or the
+   * argument position in the upper 32 bits and the pointee ID of `q` in the lower 32 bits in `(*p)(..., q, ...)`.
+   */
+  uint64_t operand;
+
+  bool operator==(const ConstraintKey &rhs) const noexcept {
+    return kind == rhs.kind && pointerId == rhs.pointerId && operand == rhs.operand;
+  }
+
+  bool operator<(const ConstraintKey &rhs) const noexcept {
+    if (kind != rhs.kind) {
+      return kind < rhs.kind;
+    }
+    if (pointerId != rhs.pointerId) {
+      return pointerId < rhs.pointerId;
+    }
+    return operand < rhs.operand;
   }
+};
+
+/**
+ * A constraint in the frozen constraint graph, stored as plain data so that the rows of the graph stay compact. The
+ * pointer on the left hand side of the constraint is given by the row that holds it.
+ */
+struct ConstraintEdge {
+  /**
+   * The pointee ID of `o` in `p = &o`, or the pointee ID of the pointer `q` on the right hand side otherwise.
+   */
+  unsigned target;
 
   /**
-   * Get the pointee set of this pointer.
+   * The kind of the constraint.
+   */
+  PointerAssignmentKind kind;
+
+  /**
+   * The ID of the index sequence in `p = &q[...]`, or `IndexSequenceTable::TrivialSequenceId` for other kinds.
+   */
+  unsigned sequenceId;
+
+  /**
+   * The argument position in `(*p)(..., q, ...)`, or 0 for other kinds.
+   */
+  unsigned argNo;
+
+  /**
+   * Determine whether this constraint is a trivial assignment `p = q`.
    *
-   * @return the pointee set of this pointer.
+   * @return whether this constraint is a trivial assignment.
    */
-  PointeeSet& GetPointeeSet() noexcept {
-    return _pointees;
+  bool isTrivialAssignment() const noexcept {
+    return kind == PointerAssignmentKind::AssignedElementPtr && sequenceId == IndexSequenceTable::TrivialSequenceId;
   }
+};
 
+/**
+ * The constraints of a program, grouped by the pointer on their left hand sides and by their kinds.
+ *
+ * Constraints are gathered in a build phase, during which duplicates are allowed. Freezing the graph removes the
+ * duplicates and lays out the constraints of each kind in compressed sparse row (CSR) form: one contiguous array holds
+ * all constraints sorted by the pointee ID of their left hand sides, and an array of offsets indexed by pointee ID
+ * delimits the constraints of each pointer. Constraints added after the graph is frozen are only visible after the
+ * graph is frozen again.
+ */
+class ConstraintGraph {
+public:
   /**
-   * Get the pointee set of this pointer.
+   * Construct a new ConstraintGraph object.
+   */
+  explicit ConstraintGraph() noexcept
+    : _assignedAddressOf(),
+      _assignedElementPtr(),
+      _assignedPointee(),
+      _pointeeAssigned(),
+      _assignedReturnValue(),
+      _argumentAssigned(),
+      _recorder(nullptr),
+      _frozen(false)
+  { }
+
+  NON_COPIABLE_NON_MOVABLE(ConstraintGraph)
+
+  /**
+   * Set the vector that receives the keys of all constraints added to this graph from now on.
    *
-   * @return the pointee set of this pointer.
+   * @param recorder the vector that receives the keys, or nullptr to stop recording.
    */
-  const PointeeSet& GetPointeeSet() const noexcept {
-    return _pointees;
+  void SetRecorder(std::vector<ConstraintKey> *recorder) noexcept {
+    _recorder = recorder;
   }
 
   /**
-   * Get the number of PointerAssignedAddressOf constraints on this pointer.
+   * Determine whether this graph has been frozen.
    *
-   * @return the number of PointerAssignedAddressOf constraints on this pointer.
+   * @return whether this graph has been frozen.
    */
-  size_t GetNumAssignedAddressOf() const noexcept {
-    return _assignedAddressOf.size();
+  bool isFrozen() const noexcept {
+    return _frozen;
   }
 
   /**
-   * Get an iterator range over all PointerAssignedAddressOf constraints on this pointer.
+   * Add a constraint `p = &o`.
    *
-   * @return an iterator range over all PointerAssignedAddressOf constraints on this pointer.
+   * @param pointer the pointer `p`.
+   * @param pointee the pointee `o`.
    */
-  auto assigned_address_of() noexcept {
-    return llvm::iterator_range<decltype(_assignedAddressOf)::iterator> { _assignedAddressOf };
-  }
+  void AddAssignedAddressOf(Pointer *pointer, Pointee *pointee) noexcept;
 
   /**
-   * Get an iterator range over all PointerAssignedAddressOf constraints on this pointer.
+   * Add a constraint `p = q`.
    *
-   * @return an iterator range over all PointerAssignedAddressOf constraints on this pointer.
+   * @param pointer the pointer `p`.
+   * @param rhsPointer the pointer `q`.
    */
-  auto assigned_address_of() const noexcept {
-    return llvm::iterator_range<decltype(_assignedAddressOf)::const_iterator> { _assignedAddressOf };
+  void AddAssignedPointer(Pointer *pointer, Pointer *rhsPointer) noexcept {
+    AddAssignedElementPtr(pointer, rhsPointer, IndexSequence::Trivial());
   }
 
   /**
-   * Get the number of PointerAssignedElementPtr constraints on this pointer.
+   * Add a constraint `p = &q[...]`.
+   *
+   * @param pointer the pointer `p`.
+   * @param rhsPointer the pointer `q`.
+   * @param indexSequence the pointer index sequence, interned by the IndexSequenceTable of the value tree.
+   */
+  void AddAssignedElementPtr(Pointer *pointer, Pointer *rhsPointer, IndexSequence indexSequence) noexcept;
+
+  /**
+   * Add a constraint `p = *q`.
+   *
+   * @param pointer the pointer `p`.
+   * @param rhsPointer the pointer `q`.
+   */
+  void AddAssignedPointee(Pointer *pointer, Pointer *rhsPointer) noexcept;
+
+  /**
+   * Add a constraint `*p = q`.
+   *
+   * @param pointer the pointer `p`.
+   * @param rhsPointer the pointer `q`.
+   */
+  void AddPointeeAssigned(Pointer *pointer, Pointer *rhsPointer) noexcept;
+
+  /**
+   * Add a constraint `p = (*q)(...)`.
+   *
+   * @param pointer the pointer `p`.
+   * @param rhsPointer the function pointer `q`.
+   */
+  void AddAssignedReturnValue(Pointer *pointer, Pointer *rhsPointer) noexcept;
+
+  /**
+   * Add a constraint `(*p)(..., q, ...)`.
+   *
+   * @param pointer the function pointer `p`.
+   * @param rhsPointer the pointer `q`.
+   * @param argNo the position of `q` in the argument list.
+   */
+  void AddArgumentAssigned(Pointer *pointer, Pointer *rhsPointer, unsigned argNo) noexcept;
+
+  /**
+   * Move the constraints gathered by another graph that has not been frozen into the build phase of this graph. The
+   * constraints added to this graph are recorded if this graph has a recorder.
+   *
+   * @param other the other graph, which is left empty.
+   * @param indexSequences the sequences interned by the IndexSequenceTable of the value tree, indexed by the IDs of the
+   * equal sequences interned by the table that the index sequences of the other graph refer to.
+   */
+  void Append(ConstraintGraph &other, llvm::ArrayRef<IndexSequence> indexSequences) noexcept;
+
+  /**
+   * Remove duplicate constraints and lay out the constraints in CSR form. The constraints added since the last call
+   * are merged with the constraints that have already been frozen.
+   *
+   * @param numPointees the number of pointees in the value tree.
+   */
+  void Freeze(size_t numPointees) noexcept;
+
+  /**
+   * Determine whether the frozen graph contains the constraint `p = q`.
+   *
+   * @param pointer the pointer `p`.
+   * @param rhsPointer the pointer `q`.
+   * @return whether the frozen graph contains the constraint `p = q`.
+   */
+  bool HasAssignedPointer(const Pointer *pointer, const Pointer *rhsPointer) const noexcept;
+
+  /**
+   * Get the number of constraints in the frozen graph.
    *
-   * @return the number of PointerAssignedElementPtr constraints on this pointer.
+   * @return the number of constraints in the frozen graph.
    */
-  size_t GetNumAssignedElementPtr() const noexcept {
-    return _assignedElementPtr.size();
+  size_t GetNumConstraints() const noexcept {
+    return _assignedAddressOf.constraints.size() + _assignedElementPtr.constraints.size() +
+        _assignedPointee.constraints.size() + _pointeeAssigned.constraints.size() +
+        _assignedReturnValue.constraints.size() + _argumentAssigned.constraints.size();
   }
 
   /**
-   * Get an iterator range over all PointerAssignedElementPtr constraints on this pointer.
+   * Get the PointerAssignedAddressOf constraints on the specified pointer in the frozen graph.
    *
-   * @return an iterator range over all PointerAssignedElementPtr constraints on this pointer.
+   * @param pointer the pointer.
+   * @return the PointerAssignedAddressOf constraints on the specified pointer.
    */
-  auto assigned_element_ptr() noexcept {
-    return llvm::iterator_range<decltype(_assignedElementPtr)::iterator> { _assignedElementPtr };
+  llvm::ArrayRef<ConstraintEdge> assigned_address_of(const Pointer *pointer) const noexcept {
+    return _assignedAddressOf.GetRow(pointer->id());
   }
 
   /**
-   * Get an iterator range over all PointerAssignedElementPtr constraints on this pointer.
+   * Get the PointerAssignedElementPtr constraints on the specified pointer in the frozen graph.
    *
-   * @return an iterator range over all PointerAssignedElementPtr constraints on this pointer.
+   * @param pointer the pointer.
+   * @return the PointerAssignedElementPtr constraints on the specified pointer.
    */
-  auto assigned_element_ptr() const noexcept {
-    return llvm::iterator_range<decltype(_assignedElementPtr)::const_iterator> { _assignedElementPtr };
+  llvm::ArrayRef<ConstraintEdge> assigned_element_ptr(const Pointer *pointer) const noexcept {
+    return _assignedElementPtr.GetRow(pointer->id());
   }
 
   /**
-   * Get the number of PointerAssignedPointee constraints on this pointer.
+   * Get the PointerAssignedPointee constraints on the specified pointer in the frozen graph.
    *
-   * @return the number of PointerAssignedPointee constraints on this pointer.
+   * @param pointer the pointer.
+   * @return the PointerAssignedPointee constraints on the specified pointer.
    */
-  size_t GetNumAssignedPointee() const noexcept {
-    return _assignedPointee.size();
+  llvm::ArrayRef<ConstraintEdge> assigned_pointee(const Pointer *pointer) const noexcept {
+    return _assignedPointee.GetRow(pointer->id());
   }
 
   /**
-   * Get an iterator range over all PointerAssignedPointee constraints on this pointer.
+   * Get the PointeeAssignedPointer constraints on the specified pointer in the frozen graph.
    *
-   * @return an iterator range over all PointerAssignedPointee constraints on this pointer.
+   * @param pointer the pointer.
+   * @return the PointeeAssignedPointer constraints on the specified pointer.
    */
-  auto assigned_pointee() noexcept {
-    return llvm::iterator_range<decltype(_assignedPointee)::iterator> { _assignedPointee };
+  llvm::ArrayRef<ConstraintEdge> pointee_assigned(const Pointer *pointer) const noexcept {
+    return _pointeeAssigned.GetRow(pointer->id());
   }
 
   /**
-   * Get an iterator range over all PointerAssignedPointee constraints on this pointer.
+   * Get the PointerAssignedReturnValue constraints on the specified pointer in the frozen graph.
    *
-   * @return an iterator range over all PointerAssignedPointee constraints on this pointer.
+   * @param pointer the pointer.
+   * @return the PointerAssignedReturnValue constraints on the specified pointer.
    */
-  auto assigned_pointee() const noexcept {
-    return llvm::iterator_range<decltype(_assignedPointee)::const_iterator> { _assignedPointee };
+  llvm::ArrayRef<ConstraintEdge> assigned_return_value(const Pointer *pointer) const noexcept {
+    return _assignedReturnValue.GetRow(pointer->id());
   }
 
   /**
-   * Get the number of PointeeAssignedPointer constraints on this pointer.
+   * Get the ArgumentAssignedPointer constraints on the specified function pointer in the frozen graph.
    *
-   * @return the number of PointeeAssignedPointer constraints on this pointer.
+   * @param pointer the function pointer.
+   * @return the ArgumentAssignedPointer constraints on the specified function pointer.
    */
-  size_t GetNumPointeeAssigned() const noexcept {
-    return _pointeeAssigned.size();
+  llvm::ArrayRef<ConstraintEdge> argument_assigned(const Pointer *pointer) const noexcept {
+    return _argumentAssigned.GetRow(pointer->id());
   }
 
-  /**
-   * Get an iterator range over all PointeeAssignedPointer constraints on this pointer.
-   *
-   * @return an iterator range over all PointeeAssignedPointer constraints on this pointer.
-   */
-  auto pointee_assigned() noexcept {
-    return llvm::iterator_range<decltype(_pointeeAssigned)::iterator> { _pointeeAssigned };
-  }
+private:
+  /**
+   * The constraints of a single kind.
+   */
+  struct ConstraintList {
+    /**
+     * Constraints gathered in the build phase, together with the pointee IDs of their left hand sides.
+     */
+    std::vector<std::pair<unsigned, ConstraintEdge>> pending;
+
+    /**
+     * The constraints on the pointer with pointee ID `i` are `constraints[offsets[i]]` to
+     * `constraints[offsets[i + 1] - 1]`.
+     */
+    std::vector<unsigned> offsets;
+
+    /**
+     * Frozen constraints sorted by the pointee IDs of their left hand sides.
+     */
+    std::vector<ConstraintEdge> constraints;
+
+    llvm::ArrayRef<ConstraintEdge> GetRow(size_t id) const noexcept {
+      if (id + 1 >= offsets.size()) {
+        return { };
+      }
+      return llvm::ArrayRef<ConstraintEdge> { constraints.data() + offsets[id], constraints.data() + offsets[id + 1] };
+    }
+  };
 
-  /**
-   * Get an iterator range over all PointeeAssignedPointer constraints on this pointer.
-   *
-   * @return an iterator range over all PointeeAssignedPointer constraints on this pointer.
-   */
-  auto pointee_assigned() const noexcept {
-    return llvm::iterator_range<decltype(_pointeeAssigned)::const_iterator> { _pointeeAssigned };
-  }
+  ConstraintList _assignedAddressOf;
+  ConstraintList _assignedElementPtr;
+  ConstraintList _assignedPointee;
+  ConstraintList _pointeeAssigned;
+  ConstraintList _assignedReturnValue;
+  ConstraintList _argumentAssigned;
+  std::vector<ConstraintKey> *_recorder;
+  bool _frozen;
 
-private:
-  std::unordered_set<PointerAssignedAddressOf, details::PolymorphicHasher<PointerAssignedAddressOf>> _assignedAddressOf;
-  std::unordered_set<PointerAssignedElementPtr, details::PolymorphicHasher<PointerAssignedElementPtr>> _assignedElementPtr;
-  std::unordered_set<PointerAssignedPointee, details::PolymorphicHasher<PointerAssignedPointee>> _assignedPointee;
-  std::unordered_set<PointeeAssignedPointer, details::PolymorphicHasher<PointeeAssignedPointer>> _pointeeAssigned;
-  PointeeSet _pointees;
+  void Add(ConstraintList &list, Pointer *pointer, ConstraintEdge edge) noexcept;
+
+  void Record(const std::pair<unsigned, ConstraintEdge> &entry) noexcept;
 };
 
 /**
@@ -930,6 +1280,11 @@ enum class ValueKind {
    * Function return values.
    */
   FunctionReturnValue,
+
+  /**
+   * The code of functions, which function pointers point to.
+   */
+  FunctionMemory,
 };
 
 /**
@@ -955,8 +1310,36 @@ struct ArgumentMemoryValueTag { };
  */
 struct FunctionReturnValueTag { };
 
+/**
+ * A tag type that distinguishes the `ValueTreeNode(FunctionMemoryValueTag, const llvm::Function *)` constructor.
+ */
+struct FunctionMemoryValueTag { };
+
+/**
+ * Options that control how aggregate values are broken down into value tree nodes.
+ */
+struct ValueTreeOptions {
+  /**
+   * Whether every array is represented by a single summary element that stands for all of its elements.
+   */
+  bool smashArrays = false;
+
+  /**
+   * Arrays with more elements than this are represented by a single summary element.
+   */
+  size_t maxArrayElements = 1024;
+
+  /**
+   * Aggregates nested deeper than this are represented by a single field-insensitive node.
+   */
+  size_t maxFieldDepth = 8;
+};
+
 /**
  * A node in the value tree.
+ *
+ * Nodes, together with their Pointee objects, are allocated in the arena of the ValueTree that owns them. The ValueTree
+ * also creates the child nodes and the Pointee object of each node.
  */
 class ValueTreeNode {
 public:
@@ -998,6 +1381,14 @@ public:
    */
   explicit ValueTreeNode(FunctionReturnValueTag, const llvm::Function *function) noexcept;
 
+  /**
+   * Construct a new ValueTreeNode object that represents the code of the specified function. Pointers to the function
+   * point to this value, which is how the targets of indirect calls are found.
+   *
+   * @param function the function.
+   */
+  explicit ValueTreeNode(FunctionMemoryValueTag, const llvm::Function *function) noexcept;
+
   /**
    * Construct a new ValueTreeNode object that represents the sub-object of the specified parent value.
    *
@@ -1083,6 +1474,15 @@ public:
     return _kind == ValueKind::FunctionReturnValue;
   }
 
+  /**
+   * Determine whether this value is the code of a function.
+   *
+   * @return whether this value is the code of a function.
+   */
+  bool isFunctionMemory() const noexcept {
+    return _kind == ValueKind::FunctionMemory;
+  }
+
   /**
    * Get the parent node of this node.
    *
@@ -1109,7 +1509,7 @@ public:
    * @return the Pointee object connected to this node.
    */
   Pointee* pointee() const noexcept {
-    return _pointee.get();
+    return _pointee;
   }
 
   /**
@@ -1148,6 +1548,8 @@ public:
     } else if (_kind == ValueKind::GlobalMemory) {
       auto globalObject = llvm::cast<llvm::GlobalObject>(_value);
       return llvm::GlobalValue::isAvailableExternallyLinkage(globalObject->getLinkage());
+    } else if (_kind == ValueKind::FunctionMemory) {
+      return llvm::cast<llvm::Function>(_value)->isDeclaration();
     }
 
     return false;
@@ -1156,10 +1558,32 @@ public:
   /**
    * Determine whether the value represented by this node is a pointer.
    *
+   * A field-insensitive aggregate that contains pointers is treated as a single pointer that holds the pointees of all
+   * the pointers within it.
+   *
    * @return whether the value represented by this node is a pointer.
    */
   bool isPointer() const noexcept {
-    return _type->isPointerTy();
+    return _isPointer;
+  }
+
+  /**
+   * Determine whether this node represents an aggregate value as a whole, without child nodes for its fields or
+   * elements.
+   *
+   * @return whether this node represents an aggregate value as a whole.
+   */
+  bool isFieldInsensitive() const noexcept {
+    return _fieldInsensitive;
+  }
+
+  /**
+   * Determine whether this node represents an array whose elements are all represented by a single summary element.
+   *
+   * @return whether this node represents a smashed array.
+   */
+  bool isSmashedArray() const noexcept {
+    return !_fieldInsensitive && _type->isArrayTy() && _numChildren != _type->getArrayNumElements();
   }
 
   /**
@@ -1216,11 +1640,11 @@ public:
   }
 
   /**
-   * Get the function from which this value is returned to the caller.
+   * Get the function from which this value is returned to the caller, or the function whose code this value is.
    *
-   * This function triggers an assertion failure if this value is not a function return value.
+   * This function triggers an assertion failure if this value is neither a function return value nor a function memory.
    *
-   * @return the function from which this value is returned to the caller.
+   * @return the function that this value belongs to.
    */
   const llvm::Function* GetFunction() const noexcept {
     if (!isRoot()) {
@@ -1235,7 +1659,7 @@ public:
    * @return whether this node has any child nodes.
    */
   bool hasChildren() const noexcept {
-    return !_children.empty();
+    return _numChildren != 0;
   }
 
   /**
@@ -1244,7 +1668,7 @@ public:
    * @return the number of child nodes under this node.
    */
   size_t GetNumChildren() const noexcept {
-    return _children.size();
+    return _numChildren;
   }
 
   /**
@@ -1256,8 +1680,8 @@ public:
    * @return the child node at the specified index.
    */
   ValueTreeNode* GetChild(size_t index) noexcept {
-    assert(index >= 0 && index < _children.size() && "index is out of range");
-    return _children[index].get();
+    assert(index >= 0 && index < _numChildren && "index is out of range");
+    return &_children[index];
   }
 
   /**
@@ -1269,8 +1693,28 @@ public:
    * @return the child node at the specified index.
    */
   const ValueTreeNode* GetChild(size_t index) const noexcept {
-    assert(index >= 0 && index < _children.size() && "index is out of range");
-    return _children[index].get();
+    assert(index >= 0 && index < _numChildren && "index is out of range");
+    return &_children[index];
+  }
+
+  /**
+   * Get the node that represents the field or element at the specified index of this aggregate value.
+   *
+   * Unlike `GetChild`, this function takes smashed arrays and field-insensitive aggregates into account: all elements
+   * of a smashed array are represented by its summary element, and all fields of a field-insensitive aggregate are
+   * represented by the aggregate itself.
+   *
+   * @param index the index of the field or element.
+   * @return the node that represents the field or element. If the index is out of range, return nullptr.
+   */
+  ValueTreeNode* GetElement(size_t index) noexcept {
+    if (_fieldInsensitive) {
+      return this;
+    }
+    if (isSmashedArray()) {
+      return index < _type->getArrayNumElements() ? &_children[0] : nullptr;
+    }
+    return index < _numChildren ? &_children[index] : nullptr;
   }
 
   /**
@@ -1307,8 +1751,8 @@ public:
       return false;
     }
 
-    for (const auto &child : _children) {
-      if (!child->Visit(visitor)) {
+    for (size_t i = 0; i < _numChildren; ++i) {
+      if (!_children[i].Visit(visitor)) {
         return false;
       }
     }
@@ -1317,30 +1761,20 @@ public:
   }
 
 private:
+  friend class ValueTree;
+
   const llvm::Type *_type;
   const llvm::Value *_value;
   ValueKind _kind;
   ValueTreeNode *_parent;
   size_t _offset;
-  std::vector<std::unique_ptr<ValueTreeNode>> _children;
-  std::unique_ptr<Pointee> _pointee;
+  ValueTreeNode *_children;
+  size_t _numChildren;
+  Pointee *_pointee;
   size_t _numPointees;
   size_t _numPointers;
-
-  void Initialize() noexcept {
-    InitializePointee();
-    InitializeChildren();
-  }
-
-  void InitializeChildren() noexcept;
-
-  void InitializePointee() noexcept {
-    if (_type->isPointerTy()) {
-      _pointee = std::make_unique<Pointer>(*this);
-    } else {
-      _pointee = std::make_unique<Pointee>(*this);
-    }
-  }
+  bool _isPointer;
+  bool _fieldInsensitive;
 };
 
 /**
@@ -1351,11 +1785,28 @@ public:
   /**
    * Construct a new ValueTree object.
    *
-   * This constructor builds all possible value trees for each rooted value in the specified module.
+   * This constructor builds the value trees of all memory values in the specified module, and of all other values in
+   * the module whose types contain a pointer. Values that cannot hold a pointer get no value tree.
    *
    * @param module the LLVM module.
+   * @param options the options that control how aggregate values are broken down into value tree nodes.
+   * @param numThreads the number of threads that build the value trees of different functions concurrently. 0 means
+   * one thread per hardware thread. The pointee IDs do not depend on the number of threads.
+   */
+  explicit ValueTree(const llvm::Module &module, const ValueTreeOptions &options = ValueTreeOptions { },
+                     unsigned numThreads = 1) noexcept;
+
+  ~ValueTree() noexcept = default;
+
+  NON_COPIABLE_NON_MOVABLE(ValueTree)
+
+  /**
+   * Build the value trees of the values in the specified function that do not have one yet. This is used to bring the
+   * value tree up to date after the function has been changed or added to the module.
+   *
+   * @param function the function.
    */
-  explicit ValueTree(const llvm::Module &module) noexcept;
+  void AddFunction(const llvm::Function &function) noexcept;
 
   /**
    * Get the number of pointees contained in the value tree.
@@ -1375,15 +1826,88 @@ public:
     return _numPointers;
   }
 
+  /**
+   * Get the table that maps pointee IDs to the pointees in this value tree.
+   *
+   * @return the table that maps pointee IDs to the pointees in this value tree.
+   */
+  PointeeTable& GetPointeeTable() noexcept {
+    return _pointeeTable;
+  }
+
+  /**
+   * Get the table that maps pointee IDs to the pointees in this value tree.
+   *
+   * @return the table that maps pointee IDs to the pointees in this value tree.
+   */
+  const PointeeTable& GetPointeeTable() const noexcept {
+    return _pointeeTable;
+  }
+
+  /**
+   * Get the pool that interns the pointee sets of the pointers in this value tree.
+   *
+   * @return the pool that interns the pointee sets of the pointers in this value tree.
+   */
+  PointeeSetPool& GetPointeeSetPool() noexcept {
+    return _pointeeSetPool;
+  }
+
+  /**
+   * Get the pool that interns the pointee sets of the pointers in this value tree.
+   *
+   * @return the pool that interns the pointee sets of the pointers in this value tree.
+   */
+  const PointeeSetPool& GetPointeeSetPool() const noexcept {
+    return _pointeeSetPool;
+  }
+
+  /**
+   * Get the graph of the constraints on the pointers in this value tree.
+   *
+   * @return the graph of the constraints on the pointers in this value tree.
+   */
+  ConstraintGraph& GetConstraintGraph() noexcept {
+    return _constraints;
+  }
+
+  /**
+   * Get the graph of the constraints on the pointers in this value tree.
+   *
+   * @return the graph of the constraints on the pointers in this value tree.
+   */
+  const ConstraintGraph& GetConstraintGraph() const noexcept {
+    return _constraints;
+  }
+
+  /**
+   * Get the table that interns the pointer index sequences of the constraints in this value tree.
+   *
+   * @return the table that interns the pointer index sequences of the constraints in this value tree.
+   */
+  IndexSequenceTable& GetIndexSequenceTable() noexcept {
+    return _indexSequences;
+  }
+
+  /**
+   * Get the table that interns the pointer index sequences of the constraints in this value tree.
+   *
+   * @return the table that interns the pointer index sequences of the constraints in this value tree.
+   */
+  const IndexSequenceTable& GetIndexSequenceTable() const noexcept {
+    return _indexSequences;
+  }
+
   /**
    * Get the value tree node corresponding to the specified rooted value.
    *
    * @param value the rooted value.
    * @return the value tree node corresponding to the specified rooted value. If the specified value is not a valid root
-   * of a value tree, return nullptr.
+   * of a value tree, e.g. because its type does not contain a pointer, return nullptr.
    */
   ValueTreeNode* GetValueNode(const llvm::Value *value) noexcept {
-    return find_in(_roots, value);
+    auto roots = FindRoots(value);
+    return roots ? roots->value : nullptr;
   }
 
   /**
@@ -1404,7 +1928,8 @@ public:
    * @return the ValueTreeNode corresponding to the stack memory.
    */
   ValueTreeNode* GetAllocaMemoryNode(const llvm::AllocaInst *inst) noexcept {
-    return find_in(_allocaMemoryRoots, inst);
+    auto roots = FindRoots(inst);
+    return roots ? roots->memory : nullptr;
   }
 
   /**
@@ -1424,7 +1949,8 @@ public:
    * @return the ValueTreeNode corresponding to the global memory.
    */
   ValueTreeNode* GetGlobalMemoryNode(const llvm::GlobalVariable *variable) noexcept {
-    return find_in(_globalMemoryRoots, variable);
+    auto roots = FindRoots(variable);
+    return roots ? roots->memory : nullptr;
   }
 
   /**
@@ -1444,7 +1970,8 @@ public:
    * @return the ValueTreeNode corresponding to the argument memory referred to by the specified argument.
    */
   ValueTreeNode* GetArgumentMemoryNode(const llvm::Argument *argument) noexcept {
-    return find_in(_argumentMemoryRoots, argument);
+    auto roots = FindRoots(argument);
+    return roots ? roots->memory : nullptr;
   }
 
   /**
@@ -1461,10 +1988,12 @@ public:
    * Get the ValueTreeNode corresponding to the return value of the specified function.
    *
    * @param function the function.
-   * @return the ValueTreeNode corresponding to the return value of the specified function.
+   * @return the ValueTreeNode corresponding to the return value of the specified function. If the return type of the
+   * function does not contain a pointer, return nullptr.
    */
   ValueTreeNode* GetFunctionReturnValueNode(const llvm::Function *function) noexcept {
-    return find_in(_returnValueRoots, function);
+    auto roots = FindRoots(function);
+    return roots ? roots->returnValue : nullptr;
   }
 
   /**
@@ -1477,13 +2006,34 @@ public:
     return const_cast<ValueTree *>(this)->GetFunctionReturnValueNode(function);
   }
 
+  /**
+   * Get the ValueTreeNode corresponding to the code of the specified function, which pointers to the function point to.
+   *
+   * @param function the function.
+   * @return the ValueTreeNode corresponding to the code of the specified function.
+   */
+  ValueTreeNode* GetFunctionMemoryNode(const llvm::Function *function) noexcept {
+    auto roots = FindRoots(function);
+    return roots ? roots->memory : nullptr;
+  }
+
+  /**
+   * Get the ValueTreeNode corresponding to the code of the specified function, which pointers to the function point to.
+   *
+   * @param function the function.
+   * @return the ValueTreeNode corresponding to the code of the specified function.
+   */
+  const ValueTreeNode* GetFunctionMemoryNode(const llvm::Function *function) const noexcept {
+    return const_cast<ValueTree *>(this)->GetFunctionMemoryNode(function);
+  }
+
   /**
    * Get the number of value roots.
    *
    * @return the number of value roots.
    */
   size_t GetNumValueRoots() const noexcept {
-    return _roots.size();
+    return _numRoots[static_cast<size_t>(ValueKind::Normal)];
   }
 
   /**
@@ -1492,7 +2042,7 @@ public:
    * @return the number of stack allocated memory roots.
    */
   size_t GetNumAllocaMemoryRoots() const noexcept {
-    return _allocaMemoryRoots.size();
+    return _numRoots[static_cast<size_t>(ValueKind::StackMemory)];
   }
 
   /**
@@ -1501,7 +2051,7 @@ public:
    * @return the number of global memory roots.
    */
   size_t GetNumGlobalMemoryRoots() const noexcept {
-    return _globalMemoryRoots.size();
+    return _numRoots[static_cast<size_t>(ValueKind::GlobalMemory)];
   }
 
   /**
@@ -1510,7 +2060,7 @@ public:
    * @return the number of argument memory roots.
    */
   size_t GetNumArgumentMemoryRoots() const noexcept {
-    return _argumentMemoryRoots.size();
+    return _numRoots[static_cast<size_t>(ValueKind::ArgumentMemory)];
   }
 
   /**
@@ -1519,12 +2069,23 @@ public:
    * @return the number of return value memory roots.
    */
   size_t GetNumReturnValueRoots() const noexcept {
-    return _returnValueRoots.size();
+    return _numRoots[static_cast<size_t>(ValueKind::FunctionReturnValue)];
+  }
+
+  /**
+   * Get the number of function memory roots.
+   *
+   * @return the number of function memory roots.
+   */
+  size_t GetNumFunctionMemoryRoots() const noexcept {
+    return _numRoots[static_cast<size_t>(ValueKind::FunctionMemory)];
   }
 
   /**
    * Visit all individual value tree nodes.
    *
+   * The nodes are visited in the order of their pointee IDs, which is a pre-order of each individual value tree.
+   *
    * The visitor should be a function object that takes a single argument of type `const ValueTreeNode &` and returns a
    * boolean value indicating whether the traversal should proceed.
    *
@@ -1534,28 +2095,8 @@ public:
    */
   template <typename Visitor>
   bool Visit(Visitor &&visitor) noexcept {
-    for (const auto &r : _roots) {
-      if (!r.second->Visit(visitor)) {
-        return false;
-      }
-    }
-    for (const auto &r : _allocaMemoryRoots) {
-      if (!r.second->Visit(visitor)) {
-        return false;
-      }
-    }
-    for (const auto &r : _globalMemoryRoots) {
-      if (!r.second->Visit(visitor)) {
-        return false;
-      }
-    }
-    for (const auto &r : _argumentMemoryRoots) {
-      if (!r.second->Visit(visitor)) {
-        return false;
-      }
-    }
-    for (const auto &r : _returnValueRoots) {
-      if (!r.second->Visit(visitor)) {
+    for (size_t id = 0; id < _pointeeTable.size(); ++id) {
+      if (!visitor(*_pointeeTable.GetPointee(id)->node())) {
         return false;
       }
     }
@@ -1564,29 +2105,108 @@ public:
 
 private:
   const llvm::Module &_module;
-  std::unordered_map<const llvm::Value *, std::unique_ptr<ValueTreeNode>> _roots;
-  std::unordered_map<const llvm::AllocaInst *, std::unique_ptr<ValueTreeNode>> _allocaMemoryRoots;
-  std::unordered_map<const llvm::GlobalVariable *, std::unique_ptr<ValueTreeNode>> _globalMemoryRoots;
-  std::unordered_map<const llvm::Argument *, std::unique_ptr<ValueTreeNode>> _argumentMemoryRoots;
-  std::unordered_map<const llvm::Function *, std::unique_ptr<ValueTreeNode>> _returnValueRoots;
+  ValueTreeOptions _options;
+
+  /**
+   * The arenas of the nodes, one per thread that builds value trees concurrently. Value trees added later are
+   * allocated in the first arena.
+   */
+  std::deque<llvm::BumpPtrAllocator> _allocators;
+
+  /**
+   * The roots of the value trees that belong to a single `llvm::Value`.
+   */
+  struct ValueRoots {
+    /**
+     * The value itself.
+     */
+    ValueTreeNode *value = nullptr;
+
+    /**
+     * The memory the value refers to: the stack memory of an `alloca`, the global memory of a global variable, the
+     * argument memory of a pointer argument or the code of a function.
+     */
+    ValueTreeNode *memory = nullptr;
+
+    /**
+     * The return value of a function.
+     */
+    ValueTreeNode *returnValue = nullptr;
+  };
+
+  /**
+   * Every value with a value tree is numbered densely: global variables first, then each function followed by its
+   * arguments and its instructions. `_valueRoots` holds the roots of the values in that order.
+   */
+  llvm::DenseMap<const llvm::Value *, unsigned> _valueIndexes;
+  std::vector<ValueRoots> _valueRoots;
+  std::array<size_t, static_cast<size_t>(ValueKind::FunctionMemory) + 1> _numRoots;
+  PointeeTable _pointeeTable;
+  PointeeSetPool _pointeeSetPool;
+  IndexSequenceTable _indexSequences;
+  ConstraintGraph _constraints;
   size_t _numPointees;
   size_t _numPointers;
 
-  template <
-      typename K, typename V,
-      typename Hasher, typename Comparer, typename Allocator,
-      typename Deleter>
-  static V* find_in(
-      std::unordered_map<K, std::unique_ptr<V, Deleter>, Hasher, Comparer, Allocator> &map,
-      const K &key) noexcept {
-    auto it = map.find(key);
-    if (it == map.end()) {
+  template <typename ...Args>
+  ValueTreeNode* CreateRoot(llvm::BumpPtrAllocator &allocator, std::vector<Pointee *> &pointees,
+                            Args&&... args) noexcept;
+
+  void NumberValues(const llvm::Function &function) noexcept;
+
+  ValueRoots& GetRoots(const llvm::Value *value) noexcept;
+
+  ValueRoots* FindRoots(const llvm::Value *value) noexcept {
+    auto it = _valueIndexes.find(value);
+    if (it == _valueIndexes.end()) {
       return nullptr;
     }
-    return it->second.get();
+    return &_valueRoots[it->second];
+  }
+
+  const ValueRoots* FindRoots(const llvm::Value *value) const noexcept {
+    return const_cast<ValueTree *>(this)->FindRoots(value);
   }
+
+  void InitializeNode(ValueTreeNode &node, size_t depth, llvm::BumpPtrAllocator &allocator,
+                      std::vector<Pointee *> &pointees) noexcept;
+
+  void AddPointees(const std::vector<Pointee *> &pointees) noexcept;
+
+  void CreateMemoryRoots(const llvm::Function &function, llvm::BumpPtrAllocator &allocator,
+                         std::vector<Pointee *> &pointees) noexcept;
+
+  void CreateValueRoots(const llvm::Function &function, llvm::BumpPtrAllocator &allocator,
+                        std::vector<Pointee *> &pointees) noexcept;
+
+  static bool ContainsPointer(const llvm::Type *type) noexcept;
 };
 
+/**
+ * Create a solver for the specified module, configured by the `-anderson-*` command line options.
+ *
+ * @param module the module to analyze.
+ * @return the solver, with the value tree of the module built and no constraints added.
+ */
+std::unique_ptr<PointsToSolver> CreateAndersonSolver(const llvm::Module &module) noexcept;
+
+/**
+ * Add the pointer assignments in the specified functions to the solver. The functions are gathered concurrently unless
+ * the solver is in incremental mode.
+ *
+ * @param solver the solver.
+ * @param functions the functions.
+ */
+void UpdateAndersonSolverOnFunctions(PointsToSolver &solver, llvm::ArrayRef<const llvm::Function *> functions) noexcept;
+
+/**
+ * Write the statistics of the solver as JSON to the file named by the `-anderson-stats` command line option. Nothing is
+ * written when the option is not set.
+ *
+ * @param solver the solver, which has collected statistics because it was created by `CreateAndersonSolver`.
+ */
+void WriteAndersonStatistics(const PointsToSolver &solver) noexcept;
+
 /**
  * Implementation of Anderson points-to analysis algorithm as a LLVM module pass.
  */
@@ -1596,28 +2216,153 @@ public:
   /**
    * Construct a new AndersonPointsToAnalysis object.
    */
-  explicit AndersonPointsToAnalysis() noexcept
-    : llvm::ModulePass { ID },
-      _valueTree(nullptr)
-  { }
+  explicit AndersonPointsToAnalysis() noexcept;
  
+  ~AndersonPointsToAnalysis() noexcept override;
 
   //NON_COPIABLE_NON_MOVABLE(AndersonPointsToAnalysis)
 
   bool runOnModule(llvm::Module &module) final;
 
+  /**
+   * Update the analysis result after the specified functions have been changed or added to the module. Only the
+   * pointers affected by the new constraints of the functions are propagated again. The module is analyzed from scratch
+   * instead if the analysis has not been run with `-anderson-incremental` or if anything has been deleted from the
+   * module.
+   *
+   * @param module the LLVM module that has been analyzed.
+   * @param changedFunctions the functions that have been changed or added to the module.
+   * @return whether the result has been updated incrementally.
+   */
+  bool UpdateFunctions(llvm::Module &module, llvm::ArrayRef<const llvm::Function *> changedFunctions) noexcept;
+
   /**
    * Get the value tree which contains analysis result.
    *
    * @return the value tree which contains analysis result.
    */
-  ValueTree* GetValueTree() const noexcept {
-    assert(_valueTree && "The analysis has not been run");
-    return _valueTree.get();
-  }
+  ValueTree* GetValueTree() const noexcept;
 
 private:
   std::unique_ptr<ValueTree> _valueTree;
+
+  /**
+   * The solver kept alive for incremental updates, which owns the value tree in incremental mode.
+   */
+  std::unique_ptr<PointsToSolver> _solver;
+};
+
+/**
+ * The result of the Anderson points-to analysis under the new pass manager, with a query API for other passes.
+ *
+ * Pointers share interned pointee sets, so the results of alias and reachability queries are memoized by pointee set
+ * rather than by value: every pair of values whose pointee sets have been compared before is answered by a single
+ * lookup.
+ */
+class AndersonResult {
+public:
+  /**
+   * Construct a new AndersonResult object.
+   *
+   * @param valueTree the solved value tree, or nullptr if `solver` owns it.
+   * @param solver the solver kept alive for incremental updates, or nullptr.
+   */
+  explicit AndersonResult(std::unique_ptr<ValueTree> valueTree, std::unique_ptr<PointsToSolver> solver) noexcept;
+
+  AndersonResult(AndersonResult &&another) noexcept;
+
+  ~AndersonResult() noexcept;
+
+  /**
+   * Determine whether this result has to be recomputed after a transformation.
+   *
+   * @param module the module.
+   * @param preserved the analyses preserved by the transformation.
+   * @param invalidator the invalidator of the module analysis manager.
+   * @return whether this result is no longer valid.
+   */
+  bool invalidate(llvm::Module &module, const llvm::PreservedAnalyses &preserved,
+                  llvm::ModuleAnalysisManager::Invalidator &invalidator) noexcept;
+
+  /**
+   * Get the value tree which contains analysis result.
+   *
+   * @return the value tree which contains analysis result.
+   */
+  ValueTree* GetValueTree() const noexcept;
+
+  /**
+   * Get the pointee set of the specified value.
+   *
+   * @param value the value.
+   * @return the pointee set of the value, or nullptr if the value is not a pointer known to the analysis.
+   */
+  const PointeeSet* GetPointeeSet(const llvm::Value *value) const noexcept;
+
+  /**
+   * Determine whether the pointee set of the specified value has been widened because the solver ran out of its budget.
+   * Bounds derived from a widened pointee set are safe but may be loose.
+   *
+   * @param value the value.
+   * @return whether the pointee set of the value has been widened.
+   */
+  bool isWidened(const llvm::Value *value) const noexcept;
+
+  /**
+   * Determine whether the two specified pointer values may point to the same object.
+   *
+   * @param lhs a pointer value.
+   * @param rhs another pointer value.
+   * @return whether the two values may point to the same object. Values unknown to the analysis may alias anything.
+   */
+  bool MayAlias(const llvm::Value *lhs, const llvm::Value *rhs) const noexcept;
+
+  /**
+   * Get the objects reachable from the specified value: the pointees of the value, and transitively the pointees of
+   * every pointer stored in a reachable object.
+   *
+   * @param value the value.
+   * @return the objects reachable from the value, or nullptr if the value is not a pointer known to the analysis.
+   */
+  const PointeeSet* GetReachableObjects(const llvm::Value *value) const noexcept;
+
+private:
+  std::unique_ptr<ValueTree> _valueTree;
+  std::unique_ptr<PointsToSolver> _solver;
+
+  /**
+   * Memoized alias queries, keyed by the pointee sets of the two values ordered by address.
+   */
+  mutable llvm::DenseMap<std::pair<const PointeeSet *, const PointeeSet *>, bool> _aliasCache;
+
+  /**
+   * Memoized reachability queries, keyed by the pointee set of the value. The reachable objects are interned into the
+   * pointee set pool of the value tree.
+   */
+  mutable llvm::DenseMap<const PointeeSet *, const PointeeSet *> _reachableCache;
+};
+
+/**
+ * Implementation of Anderson points-to analysis algorithm as a LLVM module analysis of the new pass manager. The
+ * result is cached in the module analysis manager until a transformation invalidates it.
+ */
+class AndersonAnalysis : public llvm::AnalysisInfoMixin<AndersonAnalysis> {
+public:
+  using Result = AndersonResult;
+
+  /**
+   * Run the analysis on the specified module.
+   *
+   * @param module the module.
+   * @param analysisManager the module analysis manager.
+   * @return the result of the analysis.
+   */
+  Result run(llvm::Module &module, llvm::ModuleAnalysisManager &analysisManager) noexcept;
+
+private:
+  friend llvm::AnalysisInfoMixin<AndersonAnalysis>;
+
+  static llvm::AnalysisKey Key;
 };
 
 inline bool Pointee::isPointer() const noexcept {
@@ -1628,6 +2373,14 @@ inline bool Pointee::isExternal() const noexcept {
   return _node.isExternal();
 }
 
+inline bool PointeeSet::insert(Pointee *pointee) noexcept {
+  return InsertId(static_cast<unsigned>(pointee->id()));
+}
+
+inline bool PointeeSet::contains(const Pointee *pointee) const noexcept {
+  return ContainsId(static_cast<unsigned>(pointee->id()));
+}
+
 } // namespace anderson
 
 } // namespace llvm
@@ -0,0 +1,167 @@
+#include "AndersonPointsToAnalysis.h"
+
+#include <algorithm>
+
+namespace llvm {
+
+namespace anderson {
+
+namespace {
+
+/**
+ * Get the key that orders the constraints on a single pointer. Constraints with equal keys are duplicates.
+ */
+uint64_t GetConstraintKey(const ConstraintEdge &edge) noexcept {
+  switch (edge.kind) {
+    case PointerAssignmentKind::AssignedElementPtr:
+      // Trivial assignments have the smallest index sequence ID, so they come first and are sorted by their right hand
+      // sides, which allows looking them up by binary search.
+      return (static_cast<uint64_t>(edge.sequenceId) << 32) | static_cast<uint64_t>(edge.target);
+    case PointerAssignmentKind::ArgumentAssigned:
+      return (static_cast<uint64_t>(edge.argNo) << 32) | static_cast<uint64_t>(edge.target);
+    default:
+      return edge.target;
+  }
+}
+
+/**
+ * Create a constraint whose operand on the right hand side is the specified pointee.
+ */
+ConstraintEdge MakeEdge(PointerAssignmentKind kind, const Pointee *target,
+                        unsigned sequenceId = IndexSequenceTable::TrivialSequenceId, unsigned argNo = 0) noexcept {
+  assert(target && "pointee cannot be null");
+  return ConstraintEdge { static_cast<unsigned>(target->id()), kind, sequenceId, argNo };
+}
+
+void FreezeConstraints(std::vector<std::pair<unsigned, ConstraintEdge>> &pending, std::vector<unsigned> &offsets,
+                       std::vector<ConstraintEdge> &constraints, size_t numPointees) noexcept {
+  using Entry = std::pair<unsigned, ConstraintEdge>;
+
+  // Constraints frozen before are merged with the pending ones, so that the graph can be extended after freezing.
+  for (size_t id = 0; id + 1 < offsets.size(); ++id) {
+    for (auto i = offsets[id]; i < offsets[id + 1]; ++i) {
+      pending.emplace_back(static_cast<unsigned>(id), constraints[i]);
+    }
+  }
+
+  auto less = [](const Entry &lhs, const Entry &rhs) noexcept {
+    if (lhs.first != rhs.first) {
+      return lhs.first < rhs.first;
+    }
+    return GetConstraintKey(lhs.second) < GetConstraintKey(rhs.second);
+  };
+  auto equal = [](const Entry &lhs, const Entry &rhs) noexcept {
+    return lhs.first == rhs.first && GetConstraintKey(lhs.second) == GetConstraintKey(rhs.second);
+  };
+  std::sort(pending.begin(), pending.end(), less);
+  pending.erase(std::unique(pending.begin(), pending.end(), equal), pending.end());
+
+  offsets.assign(numPointees + 1, 0);
+  constraints.clear();
+  constraints.reserve(pending.size());
+  for (const auto &entry : pending) {
+    ++offsets[entry.first + 1];
+    constraints.push_back(entry.second);
+  }
+  for (size_t id = 0; id < numPointees; ++id) {
+    offsets[id + 1] += offsets[id];
+  }
+
+  std::vector<Entry>().swap(pending);
+}
+
+} // namespace <anonymous>
+
+void ConstraintGraph::Record(const std::pair<unsigned, ConstraintEdge> &entry) noexcept {
+  if (_recorder) {
+    _recorder->push_back(ConstraintKey { entry.second.kind, entry.first, GetConstraintKey(entry.second) });
+  }
+}
+
+void ConstraintGraph::Add(ConstraintList &list, Pointer *pointer, ConstraintEdge edge) noexcept {
+  assert(pointer && "pointer cannot be null");
+  list.pending.emplace_back(pointer->id(), edge);
+  Record(list.pending.back());
+}
+
+void ConstraintGraph::AddAssignedAddressOf(Pointer *pointer, Pointee *pointee) noexcept {
+  Add(_assignedAddressOf, pointer, MakeEdge(PointerAssignmentKind::AssignedAddressOf, pointee));
+}
+
+void ConstraintGraph::AddAssignedElementPtr(Pointer *pointer, Pointer *rhsPointer,
+                                            IndexSequence indexSequence) noexcept {
+  Add(_assignedElementPtr, pointer,
+      MakeEdge(PointerAssignmentKind::AssignedElementPtr, rhsPointer, indexSequence.id()));
+}
+
+void ConstraintGraph::AddAssignedPointee(Pointer *pointer, Pointer *rhsPointer) noexcept {
+  Add(_assignedPointee, pointer, MakeEdge(PointerAssignmentKind::AssignedPointee, rhsPointer));
+}
+
+void ConstraintGraph::AddPointeeAssigned(Pointer *pointer, Pointer *rhsPointer) noexcept {
+  Add(_pointeeAssigned, pointer, MakeEdge(PointerAssignmentKind::PointeeAssigned, rhsPointer));
+}
+
+void ConstraintGraph::AddAssignedReturnValue(Pointer *pointer, Pointer *rhsPointer) noexcept {
+  Add(_assignedReturnValue, pointer, MakeEdge(PointerAssignmentKind::AssignedReturnValue, rhsPointer));
+}
+
+void ConstraintGraph::AddArgumentAssigned(Pointer *pointer, Pointer *rhsPointer, unsigned argNo) noexcept {
+  Add(_argumentAssigned, pointer,
+      MakeEdge(PointerAssignmentKind::ArgumentAssigned, rhsPointer, IndexSequenceTable::TrivialSequenceId, argNo));
+}
+
+void ConstraintGraph::Append(ConstraintGraph &other, llvm::ArrayRef<IndexSequence> indexSequences) noexcept {
+  assert(!other._frozen && "cannot append a frozen graph");
+  auto append = [this](ConstraintList &list, ConstraintList &otherList) noexcept {
+    auto &pending = list.pending;
+    auto size = pending.size();
+    pending.insert(pending.end(), otherList.pending.begin(), otherList.pending.end());
+    for (auto i = size; i < pending.size(); ++i) {
+      Record(pending[i]);
+    }
+    std::vector<std::pair<unsigned, ConstraintEdge>>().swap(otherList.pending);
+  };
+
+  // Element pointer constraints refer to the index sequences of the other graph, which are rewritten first.
+  for (auto &entry : other._assignedElementPtr.pending) {
+    auto &edge = entry.second;
+    assert(edge.sequenceId < indexSequences.size() && "unmapped index sequence");
+    edge.sequenceId = indexSequences[edge.sequenceId].id();
+  }
+
+  append(_assignedAddressOf, other._assignedAddressOf);
+  append(_assignedElementPtr, other._assignedElementPtr);
+  append(_assignedPointee, other._assignedPointee);
+  append(_pointeeAssigned, other._pointeeAssigned);
+  append(_assignedReturnValue, other._assignedReturnValue);
+  append(_argumentAssigned, other._argumentAssigned);
+}
+
+void ConstraintGraph::Freeze(size_t numPointees) noexcept {
+  FreezeConstraints(_assignedAddressOf.pending, _assignedAddressOf.offsets, _assignedAddressOf.constraints,
+                    numPointees);
+  FreezeConstraints(_assignedElementPtr.pending, _assignedElementPtr.offsets, _assignedElementPtr.constraints,
+                    numPointees);
+  FreezeConstraints(_assignedPointee.pending, _assignedPointee.offsets, _assignedPointee.constraints, numPointees);
+  FreezeConstraints(_pointeeAssigned.pending, _pointeeAssigned.offsets, _pointeeAssigned.constraints, numPointees);
+  FreezeConstraints(_assignedReturnValue.pending, _assignedReturnValue.offsets, _assignedReturnValue.constraints,
+                    numPointees);
+  FreezeConstraints(_argumentAssigned.pending, _argumentAssigned.offsets, _argumentAssigned.constraints, numPointees);
+  _frozen = true;
+}
+
+bool ConstraintGraph::HasAssignedPointer(const Pointer *pointer, const Pointer *rhsPointer) const noexcept {
+  auto row = assigned_element_ptr(pointer);
+  auto key = (static_cast<uint64_t>(IndexSequenceTable::TrivialSequenceId) << 32) |
+      static_cast<uint64_t>(rhsPointer->id());
+  auto it = std::lower_bound(row.begin(), row.end(), key,
+                             [](const ConstraintEdge &edge, uint64_t key) noexcept {
+                               return GetConstraintKey(edge) < key;
+                             });
+  return it != row.end() && GetConstraintKey(*it) == key;
+}
+
+} // namespace anderson
+
+} // namespace llvm
@@ -0,0 +1,257 @@
+#include "HashValueNumbering.h"
+
+#include <algorithm>
+
+#include <llvm/ADT/DenseSet.h>
+
+namespace llvm {
+
+namespace anderson {
+
+namespace {
+
+/**
+ * The kinds of values derived from the label of another pointer.
+ */
+enum DerivedLabelKind : size_t {
+  PointeeOf,
+  ElementPtrOf,
+  ReturnValueOf,
+};
+
+/**
+ * Collect the pointers whose pointee sets flow into the specified pointer through `p = &q[...]`, `p = *q` and
+ * `p = (*q)(...)` constraints.
+ *
+ * @param table the pointee table.
+ * @param constraints the constraint graph.
+ * @param pointer the pointer.
+ * @param dependencies the vector that receives the pointers.
+ */
+void CollectDependencies(const PointeeTable &table, const ConstraintGraph &constraints, const Pointer *pointer,
+                         std::vector<Pointer *> &dependencies) noexcept {
+  dependencies.clear();
+  for (const auto &e : constraints.assigned_element_ptr(pointer)) {
+    dependencies.push_back(table.GetPointee(e.target)->pointer());
+  }
+  for (const auto &e : constraints.assigned_pointee(pointer)) {
+    dependencies.push_back(table.GetPointee(e.target)->pointer());
+  }
+  for (const auto &e : constraints.assigned_return_value(pointer)) {
+    dependencies.push_back(table.GetPointee(e.target)->pointer());
+  }
+}
+
+} // namespace <anonymous>
+
+void HashValueNumbering::Run() noexcept {
+  const auto &table = _valueTree.GetPointeeTable();
+  const auto &constraints = _valueTree.GetConstraintGraph();
+  _labels.assign(table.size(), EmptyLabel);
+
+  // An iterative Tarjan's algorithm over the pointers, where each pointer depends on the right hand sides of its
+  // constraints. Strongly connected components are completed after all the components they depend on, so they can be
+  // labeled right away.
+  struct Frame {
+    Pointer *pointer;
+    std::vector<Pointer *> dependencies;
+    size_t nextDependency;
+  };
+
+  std::vector<size_t> indexes(table.size(), 0);
+  std::vector<size_t> lowLinks(table.size(), 0);
+  std::vector<bool> onStack(table.size(), false);
+  std::vector<Pointer *> sccStack;
+  std::vector<Frame> callStack;
+  std::vector<Pointer *> component;
+  size_t nextIndex = 1;
+
+  auto discover = [&](Pointer *pointer) noexcept {
+    auto id = pointer->id();
+    indexes[id] = lowLinks[id] = nextIndex++;
+    onStack[id] = true;
+    sccStack.push_back(pointer);
+    callStack.push_back(Frame { pointer, { }, 0 });
+    CollectDependencies(table, constraints, pointer, callStack.back().dependencies);
+  };
+
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto pointee = table.GetPointee(id);
+    if (!pointee->isPointer() || indexes[id]) {
+      continue;
+    }
+
+    discover(pointee->pointer());
+    while (!callStack.empty()) {
+      auto &frame = callStack.back();
+      auto pointerId = frame.pointer->id();
+
+      if (frame.nextDependency < frame.dependencies.size()) {
+        auto dependency = frame.dependencies[frame.nextDependency++];
+        auto dependencyId = dependency->id();
+        if (!indexes[dependencyId]) {
+          discover(dependency);
+        } else if (onStack[dependencyId]) {
+          lowLinks[pointerId] = std::min(lowLinks[pointerId], indexes[dependencyId]);
+        }
+        continue;
+      }
+
+      auto pointer = frame.pointer;
+      callStack.pop_back();
+      if (!callStack.empty()) {
+        auto parentId = callStack.back().pointer->id();
+        lowLinks[parentId] = std::min(lowLinks[parentId], lowLinks[pointerId]);
+      }
+
+      if (lowLinks[pointerId] != indexes[pointerId]) {
+        continue;
+      }
+
+      component.clear();
+      while (true) {
+        auto member = sccStack.back();
+        sccStack.pop_back();
+        onStack[member->id()] = false;
+        component.push_back(member);
+        if (member == pointer) {
+          break;
+        }
+      }
+      LabelComponent(component);
+    }
+  }
+}
+
+void HashValueNumbering::LabelComponent(const std::vector<Pointer *> &component) noexcept {
+  const auto &table = _valueTree.GetPointeeTable();
+  const auto &constraints = _valueTree.GetConstraintGraph();
+  llvm::DenseSet<unsigned> members;
+  for (auto member : component) {
+    members.insert(static_cast<unsigned>(member->id()));
+  }
+
+  // Pointers on a cycle of copy constraints share their pointee sets, so the label of the component is the union of
+  // everything flowing into it from outside. Any other constraint within the component makes its members differ.
+  std::vector<unsigned> labels;
+  auto hasIndirectMember = false;
+  for (auto pointer : component) {
+    hasIndirectMember = hasIndirectMember || isIndirect(pointer);
+
+    for (const auto &e : constraints.assigned_address_of(pointer)) {
+      labels.push_back(GetAddressLabel(table.GetPointee(e.target)));
+    }
+
+    for (const auto &e : constraints.assigned_element_ptr(pointer)) {
+      if (members.count(e.target)) {
+        if (!e.isTrivialAssignment()) {
+          for (auto member : component) {
+            _labels[member->id()] = _nextLabel++;
+          }
+          return;
+        }
+        continue;
+      }
+
+      auto rhsLabel = _labels[e.target];
+      if (rhsLabel == EmptyLabel) {
+        continue;
+      }
+      if (e.isTrivialAssignment()) {
+        labels.push_back(rhsLabel);
+        continue;
+      }
+
+      labels.push_back(GetDerivedLabel({ ElementPtrOf, rhsLabel, e.sequenceId }));
+    }
+
+    for (const auto &e : constraints.assigned_pointee(pointer)) {
+      if (members.count(e.target)) {
+        for (auto member : component) {
+          _labels[member->id()] = _nextLabel++;
+        }
+        return;
+      }
+
+      auto rhsLabel = _labels[e.target];
+      if (rhsLabel != EmptyLabel) {
+        labels.push_back(GetDerivedLabel({ PointeeOf, rhsLabel }));
+      }
+    }
+
+    // Function pointers with equal labels have the same callees, which return the same values.
+    for (const auto &e : constraints.assigned_return_value(pointer)) {
+      if (members.count(e.target)) {
+        for (auto member : component) {
+          _labels[member->id()] = _nextLabel++;
+        }
+        return;
+      }
+
+      auto rhsLabel = _labels[e.target];
+      if (rhsLabel != EmptyLabel) {
+        labels.push_back(GetDerivedLabel({ ReturnValueOf, rhsLabel }));
+      }
+    }
+  }
+
+  if (hasIndirectMember) {
+    labels.push_back(_nextLabel++);
+  }
+
+  std::sort(labels.begin(), labels.end());
+  labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+
+  unsigned label;
+  if (labels.empty()) {
+    label = EmptyLabel;
+  } else if (labels.size() == 1) {
+    label = labels.front();
+  } else {
+    label = GetUnionLabel(std::move(labels));
+  }
+
+  for (auto member : component) {
+    _labels[member->id()] = label;
+  }
+}
+
+unsigned HashValueNumbering::GetAddressLabel(const Pointee *pointee) noexcept {
+  auto result = _addressLabels.try_emplace(pointee->id(), _nextLabel);
+  if (result.second) {
+    ++_nextLabel;
+  }
+  return result.first->second;
+}
+
+unsigned HashValueNumbering::GetDerivedLabel(std::vector<size_t> key) noexcept {
+  auto result = _derivedLabels.emplace(std::move(key), _nextLabel);
+  if (result.second) {
+    ++_nextLabel;
+  }
+  return result.first->second;
+}
+
+unsigned HashValueNumbering::GetUnionLabel(std::vector<unsigned> labels) noexcept {
+  auto result = _unionLabels.emplace(std::move(labels), _nextLabel);
+  if (result.second) {
+    ++_nextLabel;
+  }
+  return result.first->second;
+}
+
+bool HashValueNumbering::isIndirect(const Pointer *pointer) noexcept {
+  // Only memory values can be the pointee of a pointer. The parameters of a function whose address is taken receive
+  // the arguments of the indirect calls that are only resolved while solving.
+  auto node = pointer->node();
+  auto kind = node->kind();
+  if (kind == ValueKind::StackMemory || kind == ValueKind::GlobalMemory || kind == ValueKind::ArgumentMemory) {
+    return true;
+  }
+  auto argument = llvm::dyn_cast_or_null<llvm::Argument>(node->value());
+  return argument && argument->getParent()->hasAddressTaken();
+}
+
+} // namespace anderson
+
+} // namespace llvm
@@ -0,0 +1,99 @@
+#ifndef LLVM_ANDERSON_SRC_HASH_VALUE_NUMBERING_H
+#define LLVM_ANDERSON_SRC_HASH_VALUE_NUMBERING_H
+
+#include "AndersonPointsToAnalysis.h"
+
+#include <map>
+#include <vector>
+
+#include <llvm/ADT/DenseMap.h>
+
+namespace llvm {
+
+namespace anderson {
+
+/**
+ * Offline pointer equivalence detection by hash-based value numbering (HVN).
+ *
+ * Every pointer is labeled by the set of values that flow into it through the constraints in the program. Pointers with
+ * equal labels are guaranteed to end up with identical pointee sets, so the solver only needs to solve one of them.
+ * Pointers that may be the pointee of another pointer receive values through `*p = q` constraints that are only
+ * discovered while solving, and so do the parameters of functions that may be called indirectly, so each of them gets a
+ * label of its own.
+ */
+class HashValueNumbering {
+public:
+  /**
+   * The label of pointers whose pointee sets are known to be empty.
+   */
+  constexpr static const unsigned EmptyLabel = 0;
+
+  /**
+   * Construct a new HashValueNumbering object.
+   *
+   * @param valueTree the value tree whose pointers are labeled. The pointee IDs must have been assigned.
+   */
+  explicit HashValueNumbering(const ValueTree &valueTree) noexcept
+    : _valueTree(valueTree),
+      _labels(),
+      _nextLabel(EmptyLabel + 1),
+      _addressLabels(),
+      _derivedLabels(),
+      _unionLabels()
+  { }
+
+  NON_COPIABLE_NON_MOVABLE(HashValueNumbering)
+
+  /**
+   * Label all pointers in the value tree.
+   */
+  void Run() noexcept;
+
+  /**
+   * Get the label of the specified pointer.
+   *
+   * @param pointer the pointer.
+   * @return the label of the pointer. Pointers with equal labels have identical pointee sets.
+   */
+  unsigned GetLabel(const Pointer *pointer) const noexcept {
+    assert(pointer->id() < _labels.size() && "the pointer has not been labeled");
+    return _labels[pointer->id()];
+  }
+
+private:
+  const ValueTree &_valueTree;
+  std::vector<unsigned> _labels;
+  unsigned _nextLabel;
+
+  /**
+   * Labels of the singleton sets `{o}` introduced by `p = &o` constraints, indexed by the ID of `o`.
+   */
+  llvm::DenseMap<size_t, unsigned> _addressLabels;
+
+  /**
+   * Labels of the values derived from the label of another pointer through `p = *q`, `p = &q[...]` or `p = (*q)(...)`
+   * constraints. The key is the constraint kind, the label of `q` and, for `p = &q[...]`, the ID of the index sequence.
+   */
+  std::map<std::vector<size_t>, unsigned> _derivedLabels;
+
+  /**
+   * Labels of the unions of two or more labels. The key is the sorted list of the labels.
+   */
+  std::map<std::vector<unsigned>, unsigned> _unionLabels;
+
+  void LabelComponent(const std::vector<Pointer *> &component) noexcept;
+
+  unsigned GetAddressLabel(const Pointee *pointee) noexcept;
+
+  unsigned GetDerivedLabel(std::vector<size_t> key) noexcept;
+
+  unsigned GetUnionLabel(std::vector<unsigned> labels) noexcept;
+
+  static bool isIndirect(const Pointer *pointer) noexcept;
+};
+
+} // namespace anderson
+
+} // namespace llvm
+
+#endif // LLVM_ANDERSON_SRC_HASH_VALUE_NUMBERING_H
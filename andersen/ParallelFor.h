@@ -0,0 +1,71 @@
+#ifndef LLVM_ANDERSON_SRC_PARALLEL_FOR_H
+#define LLVM_ANDERSON_SRC_PARALLEL_FOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+
+namespace anderson {
+
+/**
+ * Get the number of threads that `ParallelFor` runs the specified number of tasks on.
+ *
+ * @param numThreads the requested number of threads. 0 means one thread per hardware thread.
+ * @param numTasks the number of tasks.
+ * @return the number of threads, which is at least 1 and at most the number of tasks unless there are no tasks.
+ */
+inline unsigned GetNumWorkerThreads(unsigned numThreads, size_t numTasks) noexcept {
+  numThreads = numThreads ? numThreads : std::max(std::thread::hardware_concurrency(), 1u);
+  return static_cast<unsigned>(std::max<size_t>(std::min<size_t>(numThreads, numTasks), 1));
+}
+
+/**
+ * Run the tasks `0` to `numTasks - 1` on `GetNumWorkerThreads(numThreads, numTasks)` threads, including the calling
+ * thread. Tasks are handed out in increasing order as the threads become idle, so expensive tasks should come first.
+ *
+ * The task should be a function object that takes the index of the task and the index of the thread running it, which
+ * is less than the number of threads, so that each thread can keep state of its own.
+ *
+ * @tparam Task the type of the task.
+ * @param numTasks the number of tasks.
+ * @param numThreads the requested number of threads. 0 means one thread per hardware thread.
+ * @param task the task.
+ */
+template <typename Task>
+void ParallelFor(size_t numTasks, unsigned numThreads, Task &&task) noexcept {
+  numThreads = GetNumWorkerThreads(numThreads, numTasks);
+  if (numThreads == 1) {
+    for (size_t index = 0; index < numTasks; ++index) {
+      task(index, 0u);
+    }
+    return;
+  }
+
+  std::atomic<size_t> nextTask { 0 };
+  auto worker = [&task, &nextTask, numTasks](unsigned thread) noexcept {
+    size_t index;
+    while ((index = nextTask.fetch_add(1, std::memory_order_relaxed)) < numTasks) {
+      task(index, thread);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads - 1);
+  for (unsigned thread = 1; thread < numThreads; ++thread) {
+    threads.emplace_back(worker, thread);
+  }
+  worker(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+} // namespace anderson
+
+} // namespace llvm
+
+#endif // LLVM_ANDERSON_SRC_PARALLEL_FOR_H
@@ -12,11 +12,20 @@ llvm::PassPluginLibraryInfo getAndersonPointsToAnalysisPluginInfo() {
   PluginInfo.PluginVersion = LLVM_VERSION_STRING;
 
   PluginInfo.RegisterPassBuilderCallbacks = [](llvm::PassBuilder &PB) {
+    // Other passes reach the results through MAM.getResult<AndersonAnalysis>(M).
+    PB.registerAnalysisRegistrationCallback(
+        [](llvm::ModuleAnalysisManager &MAM) {
+          MAM.registerPass([] { return AndersonAnalysis(); });
+        });
     PB.registerPipelineParsingCallback(
         [](llvm::StringRef Name, llvm::ModulePassManager &MPM,
            llvm::ArrayRef<llvm::PassBuilder::PipelineElement>) {
-          if (Name == "anderson") {
-            MPM.addPass(llvm::anderson::AndersonPointsToAnalysis());
+          if (Name == "anderson" || Name == "require<anderson>") {
+            MPM.addPass(llvm::RequireAnalysisPass<AndersonAnalysis, llvm::Module>());
+            return true;
+          }
+          if (Name == "invalidate<anderson>") {
+            MPM.addPass(llvm::InvalidateAnalysisPass<AndersonAnalysis>());
             return true;
           }
           return false;
@@ -0,0 +1,236 @@
+#include "AndersonPointsToAnalysis.h"
+
+#include <llvm/ADT/Hashing.h>
+
+namespace llvm {
+
+namespace anderson {
+
+bool PointeeSet::InsertId(unsigned id) noexcept {
+  if (_bits) {
+    if (!_bits->test_and_set(id)) {
+      return false;
+    }
+    ++_numBits;
+    return true;
+  }
+
+  auto it = std::lower_bound(_ids.begin(), _ids.end(), id);
+  if (it != _ids.end() && *it == id) {
+    return false;
+  }
+  _ids.insert(it, id);
+
+  if (_table && _ids.size() > _table->GetBitVectorThreshold()) {
+    ConvertToBitVector();
+  }
+  return true;
+}
+
+bool PointeeSet::ContainsId(unsigned id) const noexcept {
+  if (_bits) {
+    return _bits->test(id);
+  }
+  return std::binary_search(_ids.begin(), _ids.end(), id);
+}
+
+void PointeeSet::ConvertToBitVector() noexcept {
+  _bits = std::make_unique<BitVector>();
+  for (auto id : _ids) {
+    _bits->set(id);
+  }
+  _numBits = _ids.size();
+  decltype(_ids)().swap(_ids);
+}
+
+bool PointeeSet::isSubset(const PointeeSet &another) const noexcept {
+  if (_bits && another._bits) {
+    return _bits->contains(*another._bits);
+  }
+  if (!_bits && !another._bits) {
+    return std::includes(_ids.begin(), _ids.end(), another._ids.begin(), another._ids.end());
+  }
+
+  auto subset = true;
+  another.ForEachId([this, &subset](unsigned id) noexcept {
+    subset = subset && ContainsId(id);
+  });
+  return subset;
+}
+
+bool PointeeSet::intersects(const PointeeSet &another) const noexcept {
+  if (_bits && another._bits) {
+    return _bits->intersects(*another._bits);
+  }
+  if (!_bits && !another._bits) {
+    auto lhs = _ids.begin();
+    auto rhs = another._ids.begin();
+    while (lhs != _ids.end() && rhs != another._ids.end()) {
+      if (*lhs == *rhs) {
+        return true;
+      }
+      if (*lhs < *rhs) {
+        ++lhs;
+      } else {
+        ++rhs;
+      }
+    }
+    return false;
+  }
+
+  // Exactly one of the sets is a sparse bitvector, which answers membership queries directly.
+  const auto &ids = _bits ? another._ids : _ids;
+  const auto &bitVectorSet = _bits ? *this : another;
+  return std::any_of(ids.begin(), ids.end(), [&bitVectorSet](unsigned id) noexcept {
+    return bitVectorSet.ContainsId(id);
+  });
+}
+
+bool PointeeSet::MergeIds(const llvm::SmallVectorImpl<unsigned> &ids) noexcept {
+  if (_bits) {
+    auto newElement = false;
+    for (auto id : ids) {
+      if (_bits->test_and_set(id)) {
+        ++_numBits;
+        newElement = true;
+      }
+    }
+    return newElement;
+  }
+
+  if (std::includes(_ids.begin(), _ids.end(), ids.begin(), ids.end())) {
+    return false;
+  }
+
+  decltype(_ids) merged;
+  merged.reserve(_ids.size() + ids.size());
+  std::set_union(_ids.begin(), _ids.end(), ids.begin(), ids.end(), std::back_inserter(merged));
+  _ids.swap(merged);
+
+  if (_table && _ids.size() > _table->GetBitVectorThreshold()) {
+    ConvertToBitVector();
+  }
+  return true;
+}
+
+bool PointeeSet::MergeFrom(const PointeeSet &source) noexcept {
+  if (!_table) {
+    _table = source._table;
+  }
+
+  if (source._bits) {
+    if (!_bits) {
+      ConvertToBitVector();
+    }
+    if (!(*_bits |= *source._bits)) {
+      return false;
+    }
+    _numBits = _bits->count();
+    return true;
+  }
+
+  return MergeIds(source._ids);
+}
+
+bool PointeeSet::MergeFrom(const PointeeSet &source, PointeeSet &added) noexcept {
+  if (!_table) {
+    _table = source._table;
+  }
+  if (!added._table) {
+    added._table = source._table;
+  }
+
+  if (source._bits) {
+    if (!_bits) {
+      ConvertToBitVector();
+    }
+
+    BitVector newBits;
+    newBits.intersectWithComplement(*source._bits, *_bits);
+    if (newBits.empty()) {
+      return false;
+    }
+
+    auto numNewBits = newBits.count();
+    *_bits |= newBits;
+    _numBits += numNewBits;
+    if (!added._bits) {
+      added.ConvertToBitVector();
+    }
+    if (added._bits->empty()) {
+      *added._bits = std::move(newBits);
+      added._numBits = numNewBits;
+    } else if (*added._bits |= newBits) {
+      added._numBits = added._bits->count();
+    }
+    return true;
+  }
+
+  decltype(_ids) newIds;
+  if (_bits) {
+    for (auto id : source._ids) {
+      if (_bits->test_and_set(id)) {
+        ++_numBits;
+        newIds.push_back(id);
+      }
+    }
+  } else {
+    std::set_difference(source._ids.begin(), source._ids.end(), _ids.begin(), _ids.end(),
+                        std::back_inserter(newIds));
+    MergeIds(newIds);
+  }
+
+  if (newIds.empty()) {
+    return false;
+  }
+  added.MergeIds(newIds);
+  return true;
+}
+
+bool PointeeSet::operator==(const PointeeSet &rhs) const noexcept {
+  if (_bits && rhs._bits) {
+    return *_bits == *rhs._bits;
+  }
+  if (!_bits && !rhs._bits) {
+    return _ids == rhs._ids;
+  }
+  return size() == rhs.size() && isSubset(rhs);
+}
+
+size_t PointeeSet::GetHashCode() const noexcept {
+  // Elements are enumerated in ascending order in both representations, so equal sets produce equal hash codes.
+  uint64_t hash = size();
+  ForEachId([&hash](unsigned id) noexcept {
+    hash = (hash ^ id) * 0x100000001b3;
+  });
+  return llvm::hash_value(hash);
+}
+
+const PointeeSet* PointeeSetPool::Intern(PointeeSet set) noexcept {
+  return &*_sets.insert(std::move(set)).first;
+}
+
+const PointeeSet* PointeeSetPool::Union(const PointeeSet *lhs, const PointeeSet *rhs) noexcept {
+  if (lhs == rhs || rhs->empty()) {
+    return lhs;
+  }
+  if (lhs->empty()) {
+    return rhs;
+  }
+
+  // Union is commutative, so both orders of the operands share a single memo entry.
+  if (std::less<const PointeeSet *> { }(rhs, lhs)) {
+    std::swap(lhs, rhs);
+  }
+  auto &result = _unions[std::make_pair(lhs, rhs)];
+  if (!result) {
+    PointeeSet merged { *lhs };
+    merged.MergeFrom(*rhs);
+    result = Intern(std::move(merged));
+  }
+  return result;
+}
+
+} // namespace anderson
+
+} // namespace llvm
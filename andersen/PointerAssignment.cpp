@@ -1,32 +1,46 @@
 #include "AndersonPointsToAnalysis.h"
 
-#include <llvm/Support/Casting.h>
-
 namespace llvm {
 
 namespace anderson {
 
-static size_t CombineHash(size_t lhs, size_t rhs) noexcept {
-  lhs ^= rhs + 0x9e3779b9 + (lhs << 6) + (lhs >> 2);
-  return lhs;
+namespace {
+
+const PointerIndex TrivialIndexSequence[] = { PointerIndex { 0 } };
+
+} // namespace <anonymous>
+
+IndexSequence IndexSequence::Trivial() noexcept {
+  return IndexSequence { IndexSequenceTable::TrivialSequenceId, TrivialIndexSequence };
 }
 
-size_t PointerAssignedElementPtr::GetHashCode() const noexcept {
-  auto baseHash = PointerAssignedPointerBase::GetHashCode();
-  for (const auto &index : _indexSequence) {
-    auto indexHash = std::hash<size_t> { }(index.index());
-    baseHash = CombineHash(baseHash, indexHash);
-  }
-  return baseHash;
+IndexSequenceTable::IndexSequenceTable() noexcept
+  : _sequences(),
+    _ids()
+{
+  auto trivial = Intern(TrivialIndexSequence);
+  (void)trivial;
+  assert(trivial.id() == TrivialSequenceId && "the trivial sequence must be interned first");
 }
 
-bool PointerAssignedElementPtr::operator==(const PointerAssignment &rhs) const noexcept {
-  if (rhs.kind() != PointerAssignmentKind::AssignedElementPtr) {
-    return false;
+IndexSequence IndexSequenceTable::Intern(llvm::ArrayRef<PointerIndex> indexes) noexcept {
+  // `p = &q[]` is the same assignment as `p = &q[0]`, so both share the trivial sequence and every trivial assignment
+  // can be recognized by its sequence ID alone.
+  if (indexes.empty()) {
+    indexes = TrivialIndexSequence;
+  }
+
+  auto it = _ids.find(indexes);
+  if (it != _ids.end()) {
+    return IndexSequence { it->second, it->first };
   }
 
-  auto rhsCasted = llvm::cast<PointerAssignedElementPtr>(rhs);
-  return pointer() == rhsCasted.pointer() && _indexSequence == rhsCasted._indexSequence;
+  // The interned copies live in a deque so that the keys of `_ids` stay valid as the table grows.
+  _sequences.emplace_back(indexes.begin(), indexes.end());
+  auto id = static_cast<unsigned>(_sequences.size() - 1);
+  llvm::ArrayRef<PointerIndex> interned { _sequences.back() };
+  _ids.try_emplace(interned, id);
+  return IndexSequence { id, interned };
 }
 
 } // namespace anderson
@@ -0,0 +1,276 @@
+#include "PointsToSnapshot.h"
+
+#include <cstring>
+#include <vector>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace llvm {
+
+namespace anderson {
+
+namespace {
+
+constexpr const char SnapshotMagic[8] = { 'A', 'N', 'D', 'S', 'N', 'A', 'P', '\0' };
+
+/**
+ * Round the specified file offset up to the alignment of 8 bytes, which is enough for every array in the file.
+ */
+uint64_t AlignOffset(uint64_t offset) noexcept {
+  return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+} // namespace <anonymous>
+
+/**
+ * The header at the start of a snapshot file. All offsets are in bytes from the start of the file and are aligned to 8
+ * bytes. Integers are stored in the byte order of the machine that writes the file; a machine of the other byte order
+ * rejects the file because the version does not match.
+ */
+struct PointsToSnapshot::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t smashArrays;
+  uint64_t maxArrayElements;
+  uint64_t maxFieldDepth;
+  uint64_t moduleHash[2];
+  uint64_t numPointees;
+  uint64_t numSets;
+  uint64_t numElements;
+
+  /**
+   * `uint8_t[numPointees]`: the ValueKind of the node of every pointee.
+   */
+  uint64_t kindsOffset;
+
+  /**
+   * `uint32_t[numPointees]`: the index of the pointee set of every pointer, or NoPointeeSet for other pointees.
+   */
+  uint64_t setIndexesOffset;
+
+  /**
+   * `uint64_t[numSets + 1]`: the start of every pointee set in the element array, followed by the number of elements.
+   */
+  uint64_t setOffsetsOffset;
+
+  /**
+   * `uint32_t[numElements]`: the sorted pointee IDs of every pointee set, one set after another.
+   */
+  uint64_t elementsOffset;
+
+  /**
+   * The size of the file in bytes.
+   */
+  uint64_t size;
+};
+
+PointsToSnapshot::PointsToSnapshot(std::unique_ptr<llvm::sys::fs::mapped_file_region> region) noexcept
+  : _region(std::move(region)),
+    _header(reinterpret_cast<const Header *>(_region->const_data())),
+    _kinds(reinterpret_cast<const uint8_t *>(_region->const_data() + _header->kindsOffset)),
+    _setIndexes(reinterpret_cast<const uint32_t *>(_region->const_data() + _header->setIndexesOffset)),
+    _setOffsets(reinterpret_cast<const uint64_t *>(_region->const_data() + _header->setOffsetsOffset)),
+    _elements(reinterpret_cast<const uint32_t *>(_region->const_data() + _header->elementsOffset))
+{ }
+
+PointsToSnapshot::~PointsToSnapshot() noexcept = default;
+
+PointsToSnapshot::ModuleHash PointsToSnapshot::ComputeModuleHash(const llvm::Module &module) noexcept {
+  llvm::SmallVector<char, 0> bitcode;
+  llvm::raw_svector_ostream os { bitcode };
+  llvm::WriteBitcodeToFile(module, os);
+
+  llvm::MD5 md5;
+  md5.update(llvm::StringRef { bitcode.data(), bitcode.size() });
+  llvm::MD5::MD5Result result;
+  md5.final(result);
+  return std::make_pair(result.high(), result.low());
+}
+
+bool PointsToSnapshot::Write(const ValueTree &valueTree, ModuleHash moduleHash, const ValueTreeOptions &options,
+                             llvm::StringRef path) noexcept {
+  // Pointers share their interned pointee sets, so every distinct set is written once.
+  const auto &table = valueTree.GetPointeeTable();
+  std::vector<uint8_t> kinds(table.size());
+  std::vector<uint32_t> setIndexes(table.size(), NoPointeeSet);
+  std::vector<uint64_t> setOffsets { 0 };
+  std::vector<uint32_t> elements;
+  llvm::DenseMap<const PointeeSet *, uint32_t> sets;
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto pointee = table.GetPointee(id);
+    kinds[id] = static_cast<uint8_t>(pointee->node()->kind());
+    if (!pointee->isPointer()) {
+      continue;
+    }
+
+    const auto &pointees = pointee->pointer()->GetPointeeSet();
+    auto result = sets.try_emplace(&pointees, static_cast<uint32_t>(setOffsets.size() - 1));
+    if (result.second) {
+      for (auto element : pointees) {
+        elements.push_back(static_cast<uint32_t>(element->id()));
+      }
+      setOffsets.push_back(elements.size());
+    }
+    setIndexes[id] = result.first->second;
+  }
+
+  Header header { };
+  std::memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+  header.version = Version;
+  header.smashArrays = options.smashArrays;
+  header.maxArrayElements = options.maxArrayElements;
+  header.maxFieldDepth = options.maxFieldDepth;
+  header.moduleHash[0] = moduleHash.first;
+  header.moduleHash[1] = moduleHash.second;
+  header.numPointees = table.size();
+  header.numSets = setOffsets.size() - 1;
+  header.numElements = elements.size();
+  header.kindsOffset = AlignOffset(sizeof(Header));
+  header.setIndexesOffset = AlignOffset(header.kindsOffset + kinds.size() * sizeof(uint8_t));
+  header.setOffsetsOffset = AlignOffset(header.setIndexesOffset + setIndexes.size() * sizeof(uint32_t));
+  header.elementsOffset = AlignOffset(header.setOffsetsOffset + setOffsets.size() * sizeof(uint64_t));
+  header.size = header.elementsOffset + elements.size() * sizeof(uint32_t);
+
+  // Each writer gets a temporary file of its own, so that concurrent compilations of the same module never publish a
+  // snapshot mixed from two writes.
+  int fd;
+  llvm::SmallString<128> temporaryPath;
+  if (llvm::sys::fs::createUniqueFile(path + ".tmp%%%%%%", fd, temporaryPath)) {
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream os { fd, /* shouldClose */ true };
+
+    auto writeArray = [&os](uint64_t offset, const void *data, size_t size) noexcept {
+      os.write_zeros(static_cast<unsigned>(offset - os.tell()));
+      os.write(static_cast<const char *>(data), size);
+    };
+    os.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    writeArray(header.kindsOffset, kinds.data(), kinds.size() * sizeof(uint8_t));
+    writeArray(header.setIndexesOffset, setIndexes.data(), setIndexes.size() * sizeof(uint32_t));
+    writeArray(header.setOffsetsOffset, setOffsets.data(), setOffsets.size() * sizeof(uint64_t));
+    writeArray(header.elementsOffset, elements.data(), elements.size() * sizeof(uint32_t));
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(temporaryPath);
+      return false;
+    }
+  }
+
+  if (llvm::sys::fs::rename(temporaryPath, path)) {
+    llvm::sys::fs::remove(temporaryPath);
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<PointsToSnapshot> PointsToSnapshot::Open(llvm::StringRef path, ModuleHash moduleHash,
+                                                         const ValueTreeOptions &options) noexcept {
+  auto file = llvm::sys::fs::openNativeFileForRead(path);
+  if (!file) {
+    llvm::consumeError(file.takeError());
+    return nullptr;
+  }
+
+  llvm::sys::fs::file_status status;
+  auto error = llvm::sys::fs::status(*file, status);
+  if (error || status.getSize() < sizeof(Header)) {
+    llvm::sys::fs::closeFile(*file);
+    return nullptr;
+  }
+  auto region = std::make_unique<llvm::sys::fs::mapped_file_region>(
+      *file, llvm::sys::fs::mapped_file_region::readonly, status.getSize(), 0, error);
+  llvm::sys::fs::closeFile(*file);
+  if (error) {
+    return nullptr;
+  }
+
+  // Everything but the arrays themselves is validated here, so that the accessors can index the arrays directly.
+  Header header;
+  std::memcpy(&header, region->const_data(), sizeof(Header));
+  auto fitsArray = [&header](uint64_t offset, uint64_t count, uint64_t elementSize) noexcept {
+    return offset % 8 == 0 && offset >= sizeof(Header) && offset <= header.size &&
+        count <= (header.size - offset) / elementSize;
+  };
+  if (std::memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 || header.version != Version ||
+      header.size != status.getSize() ||
+      header.smashArrays != static_cast<uint32_t>(options.smashArrays) ||
+      header.maxArrayElements != options.maxArrayElements || header.maxFieldDepth != options.maxFieldDepth ||
+      header.moduleHash[0] != moduleHash.first || header.moduleHash[1] != moduleHash.second ||
+      header.numPointees >= UINT32_MAX || header.numSets >= UINT32_MAX ||
+      !fitsArray(header.kindsOffset, header.numPointees, sizeof(uint8_t)) ||
+      !fitsArray(header.setIndexesOffset, header.numPointees, sizeof(uint32_t)) ||
+      !fitsArray(header.setOffsetsOffset, header.numSets + 1, sizeof(uint64_t)) ||
+      !fitsArray(header.elementsOffset, header.numElements, sizeof(uint32_t))) {
+    return nullptr;
+  }
+
+  std::unique_ptr<PointsToSnapshot> snapshot { new PointsToSnapshot(std::move(region)) };
+  for (size_t i = 0; i < header.numSets; ++i) {
+    if (snapshot->_setOffsets[i] > snapshot->_setOffsets[i + 1]) {
+      return nullptr;
+    }
+  }
+  if (snapshot->_setOffsets[0] != 0 || snapshot->_setOffsets[header.numSets] != header.numElements) {
+    return nullptr;
+  }
+  for (size_t id = 0; id < header.numPointees; ++id) {
+    auto setIndex = snapshot->_setIndexes[id];
+    if (setIndex != NoPointeeSet && setIndex >= header.numSets) {
+      return nullptr;
+    }
+  }
+  return snapshot;
+}
+
+size_t PointsToSnapshot::GetNumPointees() const noexcept {
+  return static_cast<size_t>(_header->numPointees);
+}
+
+bool PointsToSnapshot::Apply(ValueTree &valueTree) const noexcept {
+  const auto &table = valueTree.GetPointeeTable();
+  if (table.size() != GetNumPointees()) {
+    return false;
+  }
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto pointee = table.GetPointee(id);
+    if (_kinds[id] != static_cast<uint8_t>(pointee->node()->kind()) || pointee->isPointer() != isPointer(id)) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < _header->numElements; ++i) {
+    if (_elements[i] >= table.size()) {
+      return false;
+    }
+  }
+
+  // Each distinct set is interned once and shared by all pointers that refer to it.
+  auto &pool = valueTree.GetPointeeSetPool();
+  std::vector<const PointeeSet *> sets(static_cast<size_t>(_header->numSets), nullptr);
+  for (size_t id = 0; id < table.size(); ++id) {
+    if (!isPointer(id)) {
+      continue;
+    }
+
+    auto &set = sets[_setIndexes[id]];
+    if (!set) {
+      PointeeSet pointees { &table };
+      for (auto pointeeId : GetPointeeIds(id)) {
+        pointees.insert(table.GetPointee(pointeeId));
+      }
+      set = pool.Intern(std::move(pointees));
+    }
+    table.GetPointee(id)->pointer()->SetPointeeSet(set);
+  }
+  return true;
+}
+
+} // namespace anderson
+
+} // namespace llvm
@@ -0,0 +1,139 @@
+#ifndef LLVM_ANDERSON_SRC_POINTS_TO_SNAPSHOT_H
+#define LLVM_ANDERSON_SRC_POINTS_TO_SNAPSHOT_H
+
+#include "AndersonPointsToAnalysis.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+
+namespace llvm {
+
+namespace anderson {
+
+/**
+ * A solved value tree saved to disk.
+ *
+ * The snapshot file holds a fixed header followed by flat arrays: the kind of the node of every pointee, the index of
+ * the pointee set of every pointer, and the distinct pointee sets laid out as lists of sorted pointee IDs. The file is
+ * mapped into memory as is, so opening a snapshot costs no parsing and the pointee IDs can be read straight from the
+ * mapping. Pointee IDs only depend on the module and on the value tree options, so a snapshot is keyed by a hash of the
+ * module bitcode together with the options, and is only used for the exact module it was written for.
+ */
+class PointsToSnapshot {
+public:
+  /**
+   * The version of the snapshot format. Snapshots of other versions are rejected.
+   */
+  constexpr static const uint32_t Version = 3;
+
+  /**
+   * The pointee set index of pointees that are not pointers.
+   */
+  constexpr static const uint32_t NoPointeeSet = UINT32_MAX;
+
+  /**
+   * A 128-bit hash that identifies a module.
+   */
+  using ModuleHash = std::pair<uint64_t, uint64_t>;
+
+  ~PointsToSnapshot() noexcept;
+
+  NON_COPIABLE_NON_MOVABLE(PointsToSnapshot)
+
+  /**
+   * Compute the hash of the bitcode of the specified module.
+   *
+   * @param module the module.
+   * @return the hash of the bitcode of the module.
+   */
+  static ModuleHash ComputeModuleHash(const llvm::Module &module) noexcept;
+
+  /**
+   * Write a snapshot of the solved value tree to the specified file. The snapshot is written to a temporary file first,
+   * so that concurrent readers never see a partial snapshot.
+   *
+   * @param valueTree the solved value tree.
+   * @param moduleHash the hash of the module the value tree is built for.
+   * @param options the options the value tree is built with.
+   * @param path the path of the snapshot file.
+   * @return whether the snapshot has been written.
+   */
+  static bool Write(const ValueTree &valueTree, ModuleHash moduleHash, const ValueTreeOptions &options,
+                    llvm::StringRef path) noexcept;
+
+  /**
+   * Map the specified snapshot file into memory.
+   *
+   * @param path the path of the snapshot file.
+   * @param moduleHash the hash of the module being analyzed.
+   * @param options the options of the value tree of the module being analyzed.
+   * @return the mapped snapshot, or nullptr if the file does not exist, is malformed or has been written for another
+   * module, another version of the format or other options.
+   */
+  static std::unique_ptr<PointsToSnapshot> Open(llvm::StringRef path, ModuleHash moduleHash,
+                                                const ValueTreeOptions &options) noexcept;
+
+  /**
+   * Get the number of pointees in the snapshot.
+   *
+   * @return the number of pointees in the snapshot.
+   */
+  size_t GetNumPointees() const noexcept;
+
+  /**
+   * Determine whether the pointee with the specified ID is a pointer.
+   *
+   * @param id the pointee ID.
+   * @return whether the pointee is a pointer.
+   */
+  bool isPointer(size_t id) const noexcept {
+    assert(id < GetNumPointees() && "id is out of range");
+    return _setIndexes[id] != NoPointeeSet;
+  }
+
+  /**
+   * Get the IDs of the pointees of the pointer with the specified pointee ID. The IDs are read from the mapped file.
+   *
+   * @param id the pointee ID of the pointer.
+   * @return the sorted IDs of the pointees of the pointer.
+   */
+  llvm::ArrayRef<uint32_t> GetPointeeIds(size_t id) const noexcept {
+    assert(isPointer(id) && "the pointee is not a pointer");
+    auto setIndex = _setIndexes[id];
+    return llvm::ArrayRef<uint32_t> { _elements + _setOffsets[setIndex], _elements + _setOffsets[setIndex + 1] };
+  }
+
+  /**
+   * Load the pointee sets in this snapshot into the pointers of the specified value tree. The value tree must have been
+   * built for the module and with the options this snapshot has been opened for.
+   *
+   * @param valueTree the value tree.
+   * @return whether the pointee sets have been loaded. If false, the value tree does not match this snapshot and is
+   * left unchanged.
+   */
+  bool Apply(ValueTree &valueTree) const noexcept;
+
+private:
+  struct Header;
+
+  explicit PointsToSnapshot(std::unique_ptr<llvm::sys::fs::mapped_file_region> region) noexcept;
+
+  std::unique_ptr<llvm::sys::fs::mapped_file_region> _region;
+  const Header *_header;
+  const uint8_t *_kinds;
+  const uint32_t *_setIndexes;
+  const uint64_t *_setOffsets;
+  const uint32_t *_elements;
+};
+
+} // namespace anderson
+
+} // namespace llvm
+
+#endif // LLVM_ANDERSON_SRC_POINTS_TO_SNAPSHOT_H
@@ -1,43 +1,431 @@
-
 #include "PointsToSolver.h"
-#include <list>
+#include "HashValueNumbering.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/Process.h>
 
 namespace llvm {
 
 namespace anderson {
 
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t GetNanosecondsSince(Clock::time_point start) noexcept {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+} // namespace <anonymous>
+
+void PointsToSolver::Statistics::MergeFrom(const Statistics &another) noexcept {
+  numPops += another.numPops;
+  numCycleDetections += another.numCycleDetections;
+  cycleDetectionNanoseconds += another.cycleDetectionNanoseconds;
+  for (size_t kind = 0; kind < NumEdgeKinds; ++kind) {
+    relaxations[kind] += another.relaxations[kind];
+    changes[kind] += another.changes[kind];
+    nanoseconds[kind] += another.nanoseconds[kind];
+  }
+  for (size_t phase = 0; phase < NumPhases; ++phase) {
+    phaseNanoseconds[phase] += another.phaseNanoseconds[phase];
+  }
+}
+
+void PointsToSolver::BeginFunction(const llvm::Function &function) noexcept {
+  assert(!_currentFunction && "the constraints of another function are being gathered");
+  _currentFunction = &function;
+  if (_incremental) {
+    // The function may have been added or changed since the value tree was built.
+    _valueTree->AddFunction(function);
+    _currentConstraints.clear();
+    _valueTree->GetConstraintGraph().SetRecorder(&_currentConstraints);
+  }
+  AddTrivialPointerAssignments(function, _valueTree->GetConstraintGraph());
+}
+
+void PointsToSolver::EndFunction() noexcept {
+  assert(_currentFunction && "no function is being gathered");
+  auto function = const_cast<llvm::Function *>(_currentFunction);
+  _currentFunction = nullptr;
+  if (!_incremental) {
+    return;
+  }
+
+  _valueTree->GetConstraintGraph().SetRecorder(nullptr);
+  std::sort(_currentConstraints.begin(), _currentConstraints.end());
+  _currentConstraints.erase(std::unique(_currentConstraints.begin(), _currentConstraints.end()),
+                            _currentConstraints.end());
+
+  // Pointee sets only ever grow, so a constraint that is gone cannot be taken back. Constraints gathered before the
+  // first solve are all covered by it and need not be remembered as added.
+  auto &record = _functionRecords[function];
+  if (!std::includes(_currentConstraints.begin(), _currentConstraints.end(),
+                     record.constraints.begin(), record.constraints.end())) {
+    _removedConstraints = true;
+  }
+  if (!_states.empty()) {
+    std::set_difference(_currentConstraints.begin(), _currentConstraints.end(),
+                        record.constraints.begin(), record.constraints.end(), std::back_inserter(_addedConstraints));
+  }
+  record.constraints = std::move(_currentConstraints);
+  _currentConstraints.clear();
+
+  record.values.clear();
+  record.values.emplace_back(function);
+  for (auto &bb : *function) {
+    for (auto &inst : bb) {
+      record.values.emplace_back(&inst);
+    }
+  }
+}
+
+void PointsToSolver::GatherFunctions(
+    llvm::ArrayRef<const llvm::Function *> functions,
+    llvm::function_ref<void(ConstraintGatherer &, const llvm::Function &)> gather) noexcept {
+  auto &constraints = _valueTree->GetConstraintGraph();
+  auto &indexSequences = _valueTree->GetIndexSequenceTable();
+
+  // Incremental mode extends the value tree and records the constraints of every function, so functions are gathered
+  // one at a time.
+  auto numThreads = GetNumWorkerThreads(_numThreads, functions.size());
+  if (_incremental || numThreads == 1) {
+    ConstraintGatherer gatherer { *_valueTree, constraints, indexSequences };
+    for (auto function : functions) {
+      BeginFunction(*function);
+      gather(gatherer, *function);
+      EndFunction();
+    }
+    return;
+  }
+
+  // Functions differ widely in size, so there are a few chunks per thread to balance the load.
+  struct Chunk {
+    ConstraintGraph constraints;
+    IndexSequenceTable indexSequences;
+  };
+  auto numChunks = std::min<size_t>(functions.size(), static_cast<size_t>(numThreads) * 8);
+  std::vector<std::unique_ptr<Chunk>> chunks(numChunks);
+  ParallelFor(numChunks, numThreads, [&](size_t index, unsigned) noexcept {
+    auto chunk = std::make_unique<Chunk>();
+    ConstraintGatherer gatherer { *_valueTree, chunk->constraints, chunk->indexSequences };
+    auto begin = functions.size() * index / numChunks;
+    auto end = functions.size() * (index + 1) / numChunks;
+    for (auto i = begin; i < end; ++i) {
+      AddTrivialPointerAssignments(*functions[i], chunk->constraints);
+      gather(gatherer, *functions[i]);
+    }
+    chunks[index] = std::move(chunk);
+  });
+
+  // Interning the sequences of the chunks in order gives them the same IDs as gathering the functions one at a time.
+  std::vector<IndexSequence> remap;
+  for (auto &chunk : chunks) {
+    remap.clear();
+    for (unsigned id = 0; id < chunk->indexSequences.size(); ++id) {
+      remap.push_back(indexSequences.Intern(chunk->indexSequences.Get(id).indexes()));
+    }
+    constraints.Append(chunk->constraints, remap);
+  }
+}
+
 void PointsToSolver::Solve() noexcept {
+  StartBudget();
   AddTrivialPointerAssignments();
-  RelaxPointsToConstraints();
+  _valueTree->GetConstraintGraph().Freeze(_valueTree->GetPointeeTable().size());
 
-  auto converged = false;
-  auto visitor = [&converged](ValueTreeNode &node) noexcept -> bool {
-    converged = true;
-    if (!RelaxNode(node)) {
-      converged = false;
+  _states.resize(_valueTree->GetPointeeTable().size());
+  auto phaseStart = Clock::now();
+  auto finishPhase = [this, &phaseStart](Statistics::Phase phase) noexcept {
+    _statistics.phaseNanoseconds[phase] += GetNanosecondsSince(phaseStart);
+    phaseStart = Clock::now();
+  };
+  PartitionComponents();
+  finishPhase(Statistics::Partition);
+  if (_offlineEquivalence && !_incremental) {
+    MergeEquivalentPointers();
+  }
+  finishPhase(Statistics::OfflineEquivalence);
+  InitializeWorklist();
+  finishPhase(Statistics::Initialize);
+  SolveComponents();
+  finishPhase(Statistics::Propagate);
+  FinalizePointeeSets();
+  finishPhase(Statistics::Finalize);
+
+  if (_incremental) {
+    // The solver state is kept for later updates.
+    _globals.clear();
+    for (const auto &globalVariable : _module.globals()) {
+      _globals.emplace_back(const_cast<llvm::GlobalVariable *>(&globalVariable));
     }
-    return true;
+    return;
+  }
+
+  _states.clear();
+  _components.clear();
+  _componentIds.clear();
+}
+
+bool PointsToSolver::BeginUpdate(llvm::ArrayRef<const llvm::Function *> changedFunctions,
+                                 std::vector<const llvm::Function *> &functions) noexcept {
+  assert(_incremental && !_states.empty() && "the solver has not solved the module in incremental mode");
+  functions.clear();
+  _addedConstraints.clear();
+  _removedConstraints = false;
+
+  // Deleted values may have taken constraints with them, and their value trees may be found by new values that reuse
+  // their addresses.
+  auto isDeleted = [](const llvm::WeakVH &handle) noexcept {
+    return !handle;
   };
+  if (std::any_of(_globals.begin(), _globals.end(), isDeleted)) {
+    return false;
+  }
+  for (const auto &entry : _functionRecords) {
+    if (std::any_of(entry.second.values.begin(), entry.second.values.end(), isDeleted)) {
+      return false;
+    }
+  }
+  for (const auto &globalVariable : _module.globals()) {
+    if (!_valueTree->GetValueNode(&globalVariable)) {
+      return false;
+    }
+  }
 
-  while (!converged) {
-    _valueTree->Visit(visitor);
+  llvm::DenseSet<const llvm::Function *> visited;
+  for (auto function : changedFunctions) {
+    if (visited.insert(function).second) {
+      functions.push_back(function);
+    }
+  }
+  for (const auto &function : _module) {
+    if (!_functionRecords.count(&function) && visited.insert(&function).second) {
+      functions.push_back(&function);
+    }
+  }
+  return true;
+}
+
+bool PointsToSolver::Update() noexcept {
+  assert(_incremental && !_states.empty() && "the solver has not solved the module in incremental mode");
+  if (_removedConstraints) {
+    return false;
+  }
+  StartBudget();
+
+  const auto &table = _valueTree->GetPointeeTable();
+  _valueTree->GetConstraintGraph().Freeze(table.size());
+  _states.resize(table.size());
+
+  // The new constraints may connect components that have been independent so far, so all pointers are put into a
+  // single component.
+  _componentIds.assign(table.size(), 0);
+  _componentSizes.assign(1, _valueTree->GetNumPointers());
+  _components.clear();
+  _components.resize(1);
+
+  auto phaseStart = Clock::now();
+  for (const auto &key : _addedConstraints) {
+    AddConstraint(key);
+  }
+  _addedConstraints.clear();
+  _statistics.phaseNanoseconds[Statistics::Initialize] += GetNanosecondsSince(phaseStart);
+
+  phaseStart = Clock::now();
+  SolveComponents();
+  _statistics.phaseNanoseconds[Statistics::Propagate] += GetNanosecondsSince(phaseStart);
+
+  phaseStart = Clock::now();
+  FinalizePointeeSets();
+  _statistics.phaseNanoseconds[Statistics::Finalize] += GetNanosecondsSince(phaseStart);
+  return true;
+}
+
+void PointsToSolver::SolveComponents() noexcept {
+  // Only components that received pointees have anything to solve. Handing out the largest components first keeps the
+  // threads busy until the end.
+  std::vector<Component *> pendingComponents;
+  for (auto &component : _components) {
+    if (component && !component->worklist.empty()) {
+      pendingComponents.push_back(component.get());
+    }
+  }
+  std::stable_sort(pendingComponents.begin(), pendingComponents.end(),
+                   [](const Component *lhs, const Component *rhs) noexcept {
+                     return lhs->numPointers > rhs->numPointers;
+                   });
+  _numSolvedComponents = pendingComponents.size();
+
+  ParallelFor(pendingComponents.size(), _numThreads, [this, &pendingComponents](size_t index, unsigned) noexcept {
+    SolveComponent(*pendingComponents[index]);
+  });
+  if (_budgetExceeded.load(std::memory_order_relaxed)) {
+    WidenUnsolvedComponents();
+  }
+
+  for (const auto &component : _components) {
+    if (component) {
+      _numCollapsedPointers += component->numCollapsedPointers;
+      component->numCollapsedPointers = 0;
+      _statistics.MergeFrom(component->statistics);
+      component->statistics = Statistics { };
+    }
+  }
+}
+
+void PointsToSolver::SolveComponent(Component &component) noexcept {
+  // Components that start after the budget has run out are left unsolved and widened as a whole.
+  auto &worklist = component.worklist;
+  auto limited = _budget.isLimited();
+  if (limited && _budgetExceeded.load(std::memory_order_relaxed)) {
+    return;
+  }
+  uint64_t numPops = 0;
+  while (!worklist.empty()) {
+    if (limited && ++numPops == BudgetCheckInterval) {
+      numPops = 0;
+      if (!ChargeBudget(BudgetCheckInterval)) {
+        break;
+      }
+    }
+
+    auto pointer = worklist.front();
+    worklist.pop_front();
+    if (FindRepresentative(pointer) != pointer) {
+      // The pointer has been collapsed and its pending pointees have been moved to its representative.
+      continue;
+    }
+
+    ProcessPointer(pointer);
+
+    // Cycle candidates are handled in batches so that a single search covers the overlapping parts of the constraint
+    // graph reachable from several candidates.
+    auto &candidates = component.cycleCandidates;
+    if (candidates.size() >= CycleDetectionBatchSize || (worklist.empty() && !candidates.empty())) {
+      if (_collectStatistics) {
+        auto start = Clock::now();
+        DetectAndCollapseCycles(component);
+        ++component.statistics.numCycleDetections;
+        component.statistics.cycleDetectionNanoseconds += GetNanosecondsSince(start);
+      } else {
+        DetectAndCollapseCycles(component);
+      }
+    }
+  }
+  if (limited && worklist.empty()) {
+    ChargeBudget(numPops);
+  }
+
+  component.checkedCopyEdges.clear();
+}
+
+void PointsToSolver::StartBudget() noexcept {
+  _budgetDeadline = Clock::now() + std::chrono::milliseconds { _budget.milliseconds };
+  _budgetPops.store(0, std::memory_order_relaxed);
+  _budgetExceeded.store(false, std::memory_order_relaxed);
+}
+
+bool PointsToSolver::ChargeBudget(uint64_t numPops) noexcept {
+  if (_budgetExceeded.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  auto pops = _budgetPops.fetch_add(numPops, std::memory_order_relaxed) + numPops;
+  auto exceeded = (_budget.pops && pops >= _budget.pops) ||
+      (_budget.milliseconds && Clock::now() >= _budgetDeadline) ||
+      (_budget.megabytes && llvm::sys::Process::GetMallocUsage() >= (_budget.megabytes << 20));
+  if (exceeded) {
+    _budgetExceeded.store(true, std::memory_order_relaxed);
+  }
+  return !exceeded;
+}
+
+void PointsToSolver::WidenUnsolvedComponents() noexcept {
+  // Components with pending pointees have not converged. Only memory values can be pointed to and pointee sets never
+  // leave their component, so the memory values of such a component over-approximate the pointees of all its pointers.
+  const auto &table = _valueTree->GetPointeeTable();
+  std::vector<std::unique_ptr<PointeeSet>> summaries(_components.size());
+  for (size_t i = 0; i < _components.size(); ++i) {
+    auto &component = _components[i];
+    if (!component || component->worklist.empty()) {
+      continue;
+    }
+    summaries[i] = std::make_unique<PointeeSet>(&table);
+    for (auto pointer : component->worklist) {
+      GetState(pointer).queued = false;
+    }
+    component->worklist.clear();
+    component->cycleCandidates.clear();
+  }
+
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto &summary = summaries[_componentIds[id]];
+    auto node = table.GetPointee(id)->node();
+    if (summary && !node->isNormalValue() && !node->isFunctionReturnValue()) {
+      summary->insert(node->pointee());
+    }
+  }
+
+  // The summary of a component is interned once and shared by all its pointers. Outside of incremental mode the states
+  // are dropped after solving, so they are left as they are and `FinalizePointeeSets` skips the widened pointers.
+  auto &pool = _valueTree->GetPointeeSetPool();
+  std::vector<const PointeeSet *> sets(summaries.size(), nullptr);
+  for (size_t i = 0; i < summaries.size(); ++i) {
+    if (summaries[i]) {
+      sets[i] = pool.Intern(std::move(*summaries[i]));
+    }
+  }
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto set = sets[_componentIds[id]];
+    auto pointee = table.GetPointee(id);
+    if (!set || !pointee->isPointer()) {
+      continue;
+    }
+    auto pointer = pointee->pointer();
+    pointer->SetPointeeSet(set);
+    if (!pointer->isWidened()) {
+      pointer->SetWidened();
+      ++_numWidenedPointers;
+    }
+    if (_incremental && FindRepresentative(pointer) == pointer) {
+      auto &state = GetState(pointer);
+      state.pointees = *set;
+      state.delta.clear();
+    }
   }
 }
 
 void PointsToSolver::AddTrivialPointerAssignments() const noexcept {
+  auto &constraints = _valueTree->GetConstraintGraph();
+
   // Add points-to constraints from global variables to corresponding global memory values.
   for (const auto &globalVariable : _module.globals()) {
     auto globalVariableNode = _valueTree->GetValueNode(&globalVariable);
     auto globalVariableMemoryNode = _valueTree->GetGlobalMemoryNode(&globalVariable);
     assert(globalVariableNode->isPointer());
-    globalVariableNode->pointer()->AssignedAddressOf(globalVariableMemoryNode->pointee());
+    constraints.AddAssignedAddressOf(globalVariableNode->pointer(), globalVariableMemoryNode->pointee());
   }
 
+}
+
+void PointsToSolver::AddTrivialPointerAssignments(const llvm::Function &function,
+                                                  ConstraintGraph &constraints) const noexcept {
+  // Add a points-to constraint from the function pointer to the code of the function, through which indirect calls
+  // find their callees.
+  auto functionNode = _valueTree->GetValueNode(&function);
+  auto functionMemoryNode = _valueTree->GetFunctionMemoryNode(&function);
+  assert(functionNode->isPointer());
+  constraints.AddAssignedAddressOf(functionNode->pointer(), functionMemoryNode->pointee());
+
   // Add points-to constraints from exported function arguments to corresponding argument memory values.
-  for (const auto &function : _module) {
-    if (!llvm::GlobalValue::isExternalLinkage(function.getLinkage())) {
-      continue;
-    }
+  if (llvm::GlobalValue::isExternalLinkage(function.getLinkage())) {
     for (const auto &arg : function.args()) {
       if (!arg.getType()->isPointerTy()) {
         continue;
@@ -45,152 +433,717 @@ void PointsToSolver::AddTrivialPointerAssignments() const noexcept {
       auto argNode = _valueTree->GetValueNode(&arg);
       auto argMemoryNode = _valueTree->GetArgumentMemoryNode(&arg);
       assert(argNode->isPointer());
-      argNode->pointer()->AssignedAddressOf(argMemoryNode->pointee());
+      constraints.AddAssignedAddressOf(argNode->pointer(), argMemoryNode->pointee());
     }
   }
 
   // Add points-to constraints from `alloca` pointers to corresponding stack memory values.
-  for (const auto &function : _module) {
-    for (const auto &bb : function) {
-      for (const auto &inst : bb) {
-        auto allocaInst = llvm::dyn_cast<llvm::AllocaInst>(&inst);
-        if (!allocaInst) {
-          continue;
+  for (const auto &bb : function) {
+    for (const auto &inst : bb) {
+      auto allocaInst = llvm::dyn_cast<llvm::AllocaInst>(&inst);
+      if (!allocaInst) {
+        continue;
+      }
+
+      auto ptrValue = static_cast<const llvm::Value *>(&inst);
+      auto ptrNode = _valueTree->GetValueNode(ptrValue);
+      auto stackMemoryNode = _valueTree->GetAllocaMemoryNode(allocaInst);
+      assert(ptrNode->isPointer());
+
+      constraints.AddAssignedAddressOf(ptrNode->pointer(), stackMemoryNode->pointee());
+    }
+  }
+}
+
+void PointsToSolver::AddConstraint(const ConstraintKey &key) noexcept {
+  // The pointee sets solved so far already went through the worklist, so the new constraint has to be applied to them
+  // directly. Pointees added later are propagated by the worklist.
+  const auto &table = _valueTree->GetPointeeTable();
+  auto pointer = FindRepresentative(table.GetPointee(key.pointerId)->pointer());
+  if (key.kind == PointerAssignmentKind::AssignedAddressOf) {
+    AddPointee(pointer, table.GetPointee(key.operand));
+    return;
+  }
+
+  auto rhsPointer = FindRepresentative(table.GetPointee(key.operand & UINT32_MAX)->pointer());
+  switch (key.kind) {
+    case PointerAssignmentKind::AssignedElementPtr: {
+      auto indexSequence = _valueTree->GetIndexSequenceTable().Get(static_cast<unsigned>(key.operand >> 32));
+      if (indexSequence.id() == IndexSequenceTable::TrivialSequenceId) {
+        if (pointer != rhsPointer && GetState(pointer).dynamicSources.insert(rhsPointer).second) {
+          AddCopyEdge(pointer, rhsPointer);
         }
+        break;
+      }
+      auto &rhsState = GetState(rhsPointer);
+      rhsState.elementPtrUsers.emplace_back(pointer, indexSequence);
+      PropagateAssignedElementPtr(GetComponent(pointer), pointer, indexSequence, PointeeSet { rhsState.pointees });
+      break;
+    }
+    case PointerAssignmentKind::AssignedPointee: {
+      auto &rhsState = GetState(rhsPointer);
+      rhsState.pointeeUsers.push_back(pointer);
+      PointeeSet pointees { rhsState.pointees };
+      for (auto pointee : pointees) {
+        AddAssignedPointer(pointer, pointee->pointer());
+      }
+      break;
+    }
+    case PointerAssignmentKind::PointeeAssigned: {
+      auto &state = GetState(pointer);
+      state.pointeeAssignedSources.push_back(rhsPointer);
+      PointeeSet pointees { state.pointees };
+      for (auto pointee : pointees) {
+        AddAssignedPointer(pointee->pointer(), rhsPointer);
+      }
+      break;
+    }
+    case PointerAssignmentKind::AssignedReturnValue: {
+      auto &rhsState = GetState(rhsPointer);
+      rhsState.returnValueUsers.push_back(pointer);
+      PointeeSet callees { rhsState.pointees };
+      for (auto callee : callees) {
+        AddCalleeReturnValue(pointer, callee);
+      }
+      break;
+    }
+    case PointerAssignmentKind::ArgumentAssigned: {
+      auto argNo = static_cast<unsigned>(key.operand >> 32);
+      auto &state = GetState(pointer);
+      state.argumentSources.emplace_back(argNo, rhsPointer);
+      PointeeSet callees { state.pointees };
+      for (auto callee : callees) {
+        AddCalleeArgument(callee, argNo, rhsPointer);
+      }
+      break;
+    }
+    default:
+      llvm_unreachable("unexpected constraint kind");
+  }
+}
 
-        auto ptrValue = static_cast<const llvm::Value *>(&inst);
-        auto ptrNode = _valueTree->GetValueNode(ptrValue);
-        auto stackMemoryNode = _valueTree->GetAllocaMemoryNode(allocaInst);
-        assert(ptrNode->isPointer());
+void PointsToSolver::PartitionComponents() noexcept {
+  // A union-find forest over pointee IDs. Every pointee is united with the pointers it may interact with: the nodes of
+  // the same value tree, the right hand sides of the constraints of a pointer and the targets of its `p = &o`
+  // constraints. The code of a function is united with the parameters and the return value of the function, which
+  // indirect calls reach through it. Pointee sets then never leave the component of the pointer that holds them, and
+  // every constraint discovered while solving connects two pointers of the same component.
+  const auto &table = _valueTree->GetPointeeTable();
+  const auto &constraints = _valueTree->GetConstraintGraph();
+  std::vector<unsigned> parents(table.size());
+  std::iota(parents.begin(), parents.end(), 0u);
 
-        ptrNode->pointer()->AssignedAddressOf(stackMemoryNode->pointee());
+  auto find = [&parents](unsigned id) noexcept {
+    while (parents[id] != id) {
+      parents[id] = parents[parents[id]];
+      id = parents[id];
+    }
+    return id;
+  };
+  auto unite = [&parents, &find](size_t lhs, size_t rhs) noexcept {
+    auto lhsRoot = find(static_cast<unsigned>(lhs));
+    auto rhsRoot = find(static_cast<unsigned>(rhs));
+    if (lhsRoot != rhsRoot) {
+      parents[std::max(lhsRoot, rhsRoot)] = std::min(lhsRoot, rhsRoot);
+    }
+  };
+
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto pointee = table.GetPointee(id);
+    if (auto parent = pointee->node()->parent()) {
+      unite(id, parent->pointee()->id());
+    }
+    if (pointee->node()->isFunctionMemory()) {
+      auto function = pointee->node()->GetFunction();
+      for (const auto &arg : function->args()) {
+        if (auto argNode = _valueTree->GetValueNode(&arg)) {
+          unite(id, argNode->pointee()->id());
+        }
       }
+      if (auto returnValueNode = _valueTree->GetFunctionReturnValueNode(function)) {
+        unite(id, returnValueNode->pointee()->id());
+      }
+    }
+    if (!pointee->isPointer()) {
+      continue;
+    }
+
+    auto pointer = pointee->pointer();
+    for (const auto &e : constraints.assigned_address_of(pointer)) {
+      unite(id, e.target);
+    }
+    for (const auto &e : constraints.assigned_element_ptr(pointer)) {
+      unite(id, e.target);
+    }
+    for (const auto &e : constraints.assigned_pointee(pointer)) {
+      unite(id, e.target);
+    }
+    for (const auto &e : constraints.pointee_assigned(pointer)) {
+      unite(id, e.target);
+    }
+    for (const auto &e : constraints.assigned_return_value(pointer)) {
+      unite(id, e.target);
+    }
+    for (const auto &e : constraints.argument_assigned(pointer)) {
+      unite(id, e.target);
     }
   }
+
+  // Number the components densely in the order of their smallest pointee ID.
+  _componentIds.resize(table.size());
+  std::vector<size_t> numPointers;
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto root = find(static_cast<unsigned>(id));
+    if (root == id) {
+      _componentIds[id] = static_cast<unsigned>(numPointers.size());
+      numPointers.push_back(0);
+    } else {
+      _componentIds[id] = _componentIds[root];
+    }
+    if (table.GetPointee(id)->isPointer()) {
+      ++numPointers[_componentIds[id]];
+    }
+  }
+
+  _components.resize(numPointers.size());
+  _componentSizes = std::move(numPointers);
+}
+
+PointsToSolver::Component& PointsToSolver::GetComponent(const Pointer *pointer) noexcept {
+  auto componentId = _componentIds[pointer->id()];
+  auto &component = _components[componentId];
+  if (!component) {
+    component = std::make_unique<Component>();
+    component->numPointers = _componentSizes[componentId];
+  }
+  return *component;
 }
 
-void PointsToSolver::RelaxPointsToConstraints() const noexcept {
-  auto visitor = [](ValueTreeNode &node) noexcept -> bool {
+void PointsToSolver::MergeEquivalentPointers() noexcept {
+  HashValueNumbering hvn { *_valueTree };
+  hvn.Run();
+
+  // Pointers with equal labels are merged into the first pointer that carries the label, through the same union-find
+  // forest that collapses cycles while solving. Only pointers within the same component are merged, so that components
+  // stay independent.
+  const auto &table = _valueTree->GetPointeeTable();
+  llvm::DenseMap<uint64_t, Pointer *> representatives;
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto pointee = table.GetPointee(id);
+    if (!pointee->isPointer()) {
+      continue;
+    }
+
+    auto pointer = pointee->pointer();
+    auto key = (static_cast<uint64_t>(_componentIds[id]) << 32) | static_cast<uint64_t>(hvn.GetLabel(pointer));
+    auto result = representatives.try_emplace(key, pointer);
+    if (!result.second) {
+      GetState(pointer).parent = result.first->second;
+      ++_numEquivalentPointers;
+    }
+  }
+}
+
+void PointsToSolver::InitializeWorklist() noexcept {
+  // Constraints are attached to the representatives of their pointers, so merged pointers share their constraints.
+  const auto &table = _valueTree->GetPointeeTable();
+  const auto &constraints = _valueTree->GetConstraintGraph();
+  auto rhsOf = [this, &table](const ConstraintEdge &e) noexcept {
+    return FindRepresentative(table.GetPointee(e.target)->pointer());
+  };
+  auto visitor = [this, &table, &constraints, &rhsOf](ValueTreeNode &node) noexcept -> bool {
     if (!node.isPointer()) {
       return true;
     }
 
-    auto pointer = node.pointer();
-    for (auto &e : pointer->assigned_address_of()) {
-      pointer->GetPointeeSet().insert(e.pointee());
+    auto pointer = FindRepresentative(node.pointer());
+    for (auto &e : constraints.assigned_element_ptr(node.pointer())) {
+      auto rhsPointer = rhsOf(e);
+      auto &rhsState = GetState(rhsPointer);
+      if (!e.isTrivialAssignment()) {
+        rhsState.elementPtrUsers.emplace_back(pointer, _valueTree->GetIndexSequenceTable().Get(e.sequenceId));
+      } else if (rhsPointer != pointer) {
+        rhsState.copyUsers.push_back(pointer);
+      }
+    }
+
+    for (auto &e : constraints.assigned_pointee(node.pointer())) {
+      GetState(rhsOf(e)).pointeeUsers.push_back(pointer);
+    }
+
+    for (auto &e : constraints.pointee_assigned(node.pointer())) {
+      GetState(pointer).pointeeAssignedSources.push_back(rhsOf(e));
+    }
+
+    for (auto &e : constraints.assigned_return_value(node.pointer())) {
+      GetState(rhsOf(e)).returnValueUsers.push_back(pointer);
+    }
+
+    for (auto &e : constraints.argument_assigned(node.pointer())) {
+      GetState(pointer).argumentSources.emplace_back(e.argNo, rhsOf(e));
+    }
+
+    // The pointees introduced by `p = &q` constraints form the initial delta of each pointer.
+    for (auto &e : constraints.assigned_address_of(node.pointer())) {
+      AddPointee(pointer, table.GetPointee(e.target));
     }
 
     return true;
   };
 
   _valueTree->Visit(visitor);
+
+  // Merged pointers usually carry the same constraints, which would otherwise be propagated once per pointer.
+  auto removeDuplicates = [](std::vector<Pointer *> &pointers) noexcept {
+    std::sort(pointers.begin(), pointers.end(), [](const Pointer *lhs, const Pointer *rhs) noexcept {
+      return lhs->id() < rhs->id();
+    });
+    pointers.erase(std::unique(pointers.begin(), pointers.end()), pointers.end());
+  };
+  for (auto &state : _states) {
+    if (state) {
+      removeDuplicates(state->copyUsers);
+      removeDuplicates(state->pointeeUsers);
+      removeDuplicates(state->pointeeAssignedSources);
+      removeDuplicates(state->returnValueUsers);
+    }
+  }
 }
 
-bool PointsToSolver::RelaxNode(ValueTreeNode &node) noexcept {
-  if (!node.isPointer()) {
-    return true;
+PointsToSolver::PointerState& PointsToSolver::GetState(const Pointer *pointer) noexcept {
+  auto &state = _states[pointer->id()];
+  if (!state) {
+    state = std::make_unique<PointerState>(&_valueTree->GetPointeeTable());
   }
+  return *state;
+}
 
-  auto nodeConverged = true;
-  auto pointer = node.pointer();
+void PointsToSolver::Enqueue(Pointer *pointer, PointerState &state) noexcept {
+  if (!state.queued) {
+    state.queued = true;
+    GetComponent(pointer).worklist.push_back(pointer);
+  }
+}
 
-  for (auto &e : pointer->assigned_pointee()) {
-    if (!RelaxAssignedPointee(pointer, e)) {
-      nodeConverged = false;
+Pointer* PointsToSolver::FindRepresentative(Pointer *pointer) noexcept {
+  auto representative = pointer;
+  while (auto parent = GetState(representative).parent) {
+    representative = parent;
+  }
+
+  while (pointer != representative) {
+    auto &state = GetState(pointer);
+    auto parent = state.parent;
+    state.parent = representative;
+    pointer = parent;
+  }
+
+  return representative;
+}
+
+void PointsToSolver::ProcessPointer(Pointer *pointer) noexcept {
+  auto &component = GetComponent(pointer);
+  auto &state = GetState(pointer);
+  state.queued = false;
+
+  PointeeSet delta { &_valueTree->GetPointeeTable() };
+  std::swap(delta, state.delta);
+
+  // Statistics are recorded through a null pointer check when they are disabled.
+  auto statistics = _collectStatistics ? &component.statistics : nullptr;
+  auto start = statistics ? Clock::now() : Clock::time_point { };
+  auto finishEdges = [statistics, &start](Statistics::EdgeKind kind) noexcept {
+    if (statistics) {
+      statistics->nanoseconds[kind] += GetNanosecondsSince(start);
+      start = Clock::now();
+    }
+  };
+  auto recordRelaxation = [statistics](Statistics::EdgeKind kind, bool changed) noexcept {
+    if (statistics) {
+      ++statistics->relaxations[kind];
+      statistics->changes[kind] += changed;
+    }
+  };
+  if (statistics) {
+    ++statistics->numPops;
+  }
+
+  // The user lists may grow while the delta is being propagated, so they are walked by index rather than by iterator.
+  // Users added during the walk have already received the full pointee set of this pointer.
+  for (size_t i = 0; i < state.copyUsers.size(); ++i) {
+    auto user = FindRepresentative(state.copyUsers[i]);
+    if (user == pointer) {
+      continue;
+    }
+
+    auto &userState = GetState(user);
+    auto changed = userState.pointees.MergeFrom(delta, userState.delta);
+    if (changed) {
+      Enqueue(user, userState);
+    }
+    recordRelaxation(Statistics::Copy, changed);
+
+    // Lazy cycle detection: a copy edge whose two ends hold identical pointee sets is likely to lie on a cycle. Each
+    // edge triggers the detection at most once. The user has received every pointee of this pointer by now, so the two
+    // pointee sets are identical exactly when their sizes are.
+    auto edgeKey = (static_cast<uint64_t>(pointer->id()) << 32) | static_cast<uint64_t>(user->id());
+    if (userState.pointees.size() == state.pointees.size() &&
+        component.checkedCopyEdges.insert(edgeKey).second) {
+      component.cycleCandidates.emplace_back(pointer, user);
     }
   }
 
-  for (auto &e : pointer->assigned_element_ptr()) {
-    if (!RelaxAssignedElementPtr(pointer, e)) {
-      nodeConverged = false;
+  finishEdges(Statistics::Copy);
+
+  for (size_t i = 0; i < state.elementPtrUsers.size(); ++i) {
+    auto user = state.elementPtrUsers[i];
+    auto changed = PropagateAssignedElementPtr(component, FindRepresentative(user.first), user.second, delta);
+    recordRelaxation(Statistics::ElementPtr, changed);
+  }
+  finishEdges(Statistics::ElementPtr);
+
+  // `p = *q`: every new pointee of `q` becomes a new right hand side of `p`.
+  for (size_t i = 0; i < state.pointeeUsers.size(); ++i) {
+    auto user = state.pointeeUsers[i];
+    for (auto pointee : delta) {
+      assert(pointee->isPointer());
+      recordRelaxation(Statistics::AssignedPointee, AddAssignedPointer(user, pointee->pointer()));
     }
   }
+  finishEdges(Statistics::AssignedPointee);
 
-  for (auto &e : pointer->pointee_assigned()) {
-    if (!RelaxPointeeAssigned(pointer, e)) {
-      nodeConverged = false;
+  // `*p = q`: every new pointee of `p` is assigned with `q`.
+  for (size_t i = 0; i < state.pointeeAssignedSources.size(); ++i) {
+    auto source = state.pointeeAssignedSources[i];
+    for (auto pointee : delta) {
+      assert(pointee->isPointer());
+      recordRelaxation(Statistics::PointeeAssigned, AddAssignedPointer(pointee->pointer(), source));
+    }
+  }
+  finishEdges(Statistics::PointeeAssigned);
+
+  // `p = (*q)(...)` and `(*q)(..., r, ...)`: every new function pointed to by `q` is a new callee of the call, whose
+  // return value flows into `p` and whose parameters receive the arguments.
+  for (size_t i = 0; i < state.returnValueUsers.size(); ++i) {
+    auto user = state.returnValueUsers[i];
+    for (auto pointee : delta) {
+      recordRelaxation(Statistics::Call, AddCalleeReturnValue(user, pointee));
+    }
+  }
+  for (size_t i = 0; i < state.argumentSources.size(); ++i) {
+    auto source = state.argumentSources[i];
+    for (auto pointee : delta) {
+      recordRelaxation(Statistics::Call, AddCalleeArgument(pointee, source.first, source.second));
     }
   }
+  finishEdges(Statistics::Call);
+}
+
+bool PointsToSolver::AddAssignedPointer(Pointer *pointer, Pointer *rhsPointer) noexcept {
+  pointer = FindRepresentative(pointer);
+  rhsPointer = FindRepresentative(rhsPointer);
+  if (pointer == rhsPointer || _valueTree->GetConstraintGraph().HasAssignedPointer(pointer, rhsPointer) ||
+      !GetState(pointer).dynamicSources.insert(rhsPointer).second) {
+    return false;
+  }
 
-  return nodeConverged;
+  AddCopyEdge(pointer, rhsPointer);
+  return true;
 }
 
-bool PointsToSolver::RelaxAssignedPointee(Pointer *pointer, const PointerAssignedPointee &edge) noexcept {
-  auto converged = true;
+bool PointsToSolver::AddCalleeReturnValue(Pointer *pointer, const Pointee *callee) noexcept {
+  if (!callee->node()->isFunctionMemory()) {
+    return false;
+  }
 
-  auto rhsPointer = edge.pointer();
-  for (auto pointee : rhsPointer->GetPointeeSet()) {
-    assert(pointee->isPointer());
-    if (pointer->AssignedPointer(pointee->pointer())) {
-      converged = false;
-    }
+  // Callees that do not return a pointer contribute nothing, e.g. when the function pointer has been cast.
+  auto returnValueNode = _valueTree->GetFunctionReturnValueNode(callee->node()->GetFunction());
+  if (!returnValueNode || !returnValueNode->isPointer()) {
+    return false;
+  }
+  return AddAssignedPointer(pointer, returnValueNode->pointer());
+}
+
+bool PointsToSolver::AddCalleeArgument(const Pointee *callee, unsigned argNo, Pointer *argument) noexcept {
+  if (!callee->node()->isFunctionMemory()) {
+    return false;
   }
 
-  return converged;
+  // Arguments beyond the parameters of the callee are variadic arguments, which are not tracked.
+  auto function = callee->node()->GetFunction();
+  if (argNo >= function->arg_size()) {
+    return false;
+  }
+  auto paramNode = _valueTree->GetValueNode(function->getArg(argNo));
+  if (!paramNode || !paramNode->isPointer()) {
+    return false;
+  }
+  return AddAssignedPointer(paramNode->pointer(), argument);
 }
 
-bool PointsToSolver::RelaxAssignedElementPtr(Pointer *pointer, const PointerAssignedElementPtr &edge) noexcept {
-  auto rhsPointer = edge.pointer();
+void PointsToSolver::AddCopyEdge(Pointer *pointer, Pointer *rhsPointer) noexcept {
+  GetState(rhsPointer).copyUsers.push_back(pointer);
 
-  std::list<ValueTreeNode *> elementNodes;
-  for (auto pointee : rhsPointer->GetPointeeSet()) {
-    elementNodes.push_back(pointee->node());
+  auto &state = GetState(pointer);
+  if (state.pointees.MergeFrom(GetState(rhsPointer).pointees, state.delta)) {
+    Enqueue(pointer, state);
   }
+}
+
+void PointsToSolver::DetectAndCollapseCycles(Component &component) noexcept {
+  // An iterative Tarjan's algorithm over the copy constraints reachable from the cycle candidates. Pointers on a common
+  // cycle end up with identical pointee sets, so the search does not step into pointers whose pointee sets differ from
+  // the one of the candidate it starts from. This keeps each detection local at the cost of missing cycles whose
+  // members have not converged yet.
+  struct Frame {
+    Pointer *pointer;
+    size_t nextUser;
+  };
+
+  llvm::DenseMap<Pointer *, size_t> indexes;
+  llvm::DenseMap<Pointer *, size_t> lowLinks;
+  llvm::DenseSet<Pointer *> onStack;
+  std::vector<Pointer *> sccStack;
+  std::vector<Frame> callStack;
+
+  auto discover = [&](Pointer *pointer) noexcept {
+    auto index = indexes.size();
+    indexes[pointer] = index;
+    lowLinks[pointer] = index;
+    onStack.insert(pointer);
+    sccStack.push_back(pointer);
+    callStack.push_back(Frame { pointer, 0 });
+  };
+
+  for (const auto &candidate : component.cycleCandidates) {
+    auto start = FindRepresentative(candidate.first);
+    if (start == FindRepresentative(candidate.second) || indexes.count(start)) {
+      continue;
+    }
 
-  for (const auto &index : edge.index_sequence()) {
-    if (index.isConstant()) {
-      auto indexValue = index.index();
-      for (auto it = elementNodes.begin(); it != elementNodes.end(); ) {
-        auto &node = *it;
-        if (node->type()->isArrayTy() || node->type()->isStructTy()) {
-          node = node->GetChild(indexValue);
-        } else {
-          it = elementNodes.erase(it);
+    const auto &startPointees = GetState(start).pointees;
+    discover(start);
+    while (!callStack.empty()) {
+      auto pointer = callStack.back().pointer;
+      auto &users = GetState(pointer).copyUsers;
+
+      if (callStack.back().nextUser < users.size()) {
+        auto user = FindRepresentative(users[callStack.back().nextUser++]);
+        const auto &userPointees = GetState(user).pointees;
+        if (user == pointer || userPointees.size() != startPointees.size() || userPointees != startPointees) {
           continue;
         }
-        ++it;
-      }
-    } else {
-      std::list<ValueTreeNode *> nextElementNodes;
-      for (auto node : elementNodes) {
-        if (!node->type()->isArrayTy() && !node->type()->isStructTy()) {
-          continue;
+
+        auto it = indexes.find(user);
+        if (it == indexes.end()) {
+          discover(user);
+        } else if (onStack.count(user)) {
+          lowLinks[pointer] = std::min(lowLinks[pointer], it->second);
         }
-        for (size_t i = 0; i < node->GetNumChildren(); ++i) {
-          nextElementNodes.push_back(node->GetChild(i));
+        continue;
+      }
+
+      callStack.pop_back();
+      if (!callStack.empty()) {
+        auto parent = callStack.back().pointer;
+        lowLinks[parent] = std::min(lowLinks[parent], lowLinks[pointer]);
+      }
+
+      if (lowLinks[pointer] != indexes[pointer]) {
+        continue;
+      }
+
+      // `pointer` is the root of a strongly connected component. Merge all other members into it.
+      while (true) {
+        auto member = sccStack.back();
+        sccStack.pop_back();
+        onStack.erase(member);
+        if (member == pointer) {
+          break;
         }
+        CollapsePointer(pointer, member);
+      }
+    }
+  }
+
+  component.cycleCandidates.clear();
+}
+
+void PointsToSolver::CollapsePointer(Pointer *representative, Pointer *pointer) noexcept {
+  auto &representativeState = GetState(representative);
+  auto &state = GetState(pointer);
+  state.parent = representative;
+  ++GetComponent(representative).numCollapsedPointers;
+
+  // The users of either pointer have only seen the pointees propagated from that pointer, so the pointees missing on
+  // either side have to be propagated again from the representative.
+  auto table = &_valueTree->GetPointeeTable();
+  PointeeSet missingFromPointer { table };
+  PointeeSet missingFromRepresentative { table };
+  state.pointees.MergeFrom(representativeState.pointees, missingFromPointer);
+  representativeState.pointees.MergeFrom(state.pointees, missingFromRepresentative);
+
+  representativeState.delta.MergeFrom(state.delta);
+  representativeState.delta.MergeFrom(missingFromPointer);
+  representativeState.delta.MergeFrom(missingFromRepresentative);
+  state.delta.clear();
+  state.pointees.clear();
+
+  auto moveAppend = [](auto &target, auto &source) noexcept {
+    target.insert(target.end(), source.begin(), source.end());
+    std::remove_reference_t<decltype(source)>().swap(source);
+  };
+  moveAppend(representativeState.copyUsers, state.copyUsers);
+  moveAppend(representativeState.elementPtrUsers, state.elementPtrUsers);
+  moveAppend(representativeState.pointeeUsers, state.pointeeUsers);
+  moveAppend(representativeState.pointeeAssignedSources, state.pointeeAssignedSources);
+  moveAppend(representativeState.returnValueUsers, state.returnValueUsers);
+  moveAppend(representativeState.argumentSources, state.argumentSources);
+
+  if (!representativeState.delta.empty()) {
+    Enqueue(representative, representativeState);
+  }
+}
+
+void PointsToSolver::FinalizePointeeSets() noexcept {
+  // Representatives intern their pointee sets first, and the pointers merged into them share the interned sets.
+  // Pointers without any state keep the empty set they were created with. In incremental mode the solver keeps its
+  // pointee sets, and since they only ever grow, a set whose size has not changed since the last solve is up to date.
+  const auto &table = _valueTree->GetPointeeTable();
+  auto &pool = _valueTree->GetPointeeSetPool();
+  for (size_t id = 0; id < _states.size(); ++id) {
+    auto &state = _states[id];
+    if (!state || state->parent) {
+      continue;
+    }
+    auto pointer = table.GetPointee(id)->pointer();
+    if (!_incremental) {
+      if (!pointer->isWidened()) {
+        pointer->SetPointeeSet(pool.Intern(std::move(state->pointees)));
       }
-      elementNodes.swap(nextElementNodes);
+    } else if (pointer->GetPointeeSet().size() != state->pointees.size()) {
+      pointer->SetPointeeSet(pool.Intern(PointeeSet { state->pointees }));
     }
   }
 
-  auto converged = true;
-  for (auto node : elementNodes) {
-    if (!node->isPointer()) {
+  for (size_t id = 0; id < _states.size(); ++id) {
+    if (!_states[id] || !_states[id]->parent) {
       continue;
     }
-    if (pointer->GetPointeeSet().MergeFrom(node->pointer()->GetPointeeSet())) {
-      converged = false;
+    auto pointer = table.GetPointee(id)->pointer();
+    pointer->SetPointeeSet(&FindRepresentative(pointer)->GetPointeeSet());
+  }
+}
+
+void PointsToSolver::AddPointee(Pointer *pointer, Pointee *pointee) noexcept {
+  auto &state = GetState(pointer);
+  if (!state.pointees.insert(pointee)) {
+    return;
+  }
+
+  state.delta.insert(pointee);
+  Enqueue(pointer, state);
+}
+
+bool PointsToSolver::PropagateAssignedElementPtr(Component &component, Pointer *pointer, IndexSequence indexSequence,
+                                                 const PointeeSet &pointees) noexcept {
+  // The selected elements are collected into a single set first, so that they are merged into the pointee set of the
+  // pointer at once.
+  const auto &table = _valueTree->GetPointeeTable();
+  auto indexes = indexSequence.indexes();
+  PointeeSet elements { &table };
+  auto addElements = [&](ValueTreeNode *node, size_t depth) noexcept {
+    auto baseId = node->pointee()->id();
+    if (indexes.size() == 1) {
+      elements.insert(table.GetPointee(baseId));
+      return;
+    }
+    for (auto offset : GetElementOffsets(component, node, depth, indexSequence)) {
+      elements.insert(table.GetPointee(baseId + offset));
+    }
+  };
+
+  for (auto pointee : pointees) {
+    if (indexes.empty()) {
+      elements.insert(const_cast<Pointee *>(pointee));
+      continue;
+    }
+
+    auto baseNode = const_cast<ValueTreeNode *>(pointee->node());
+    auto baseParent = baseNode->parent();
+    size_t depth = 0;
+    for (auto node = baseParent; node; node = node->parent()) {
+      ++depth;
+    }
+
+    // The first index performs pointer arithmetic on the pointee itself. It can only move the pointer to a sibling
+    // element when the pointee lives inside an array; otherwise the pointer keeps pointing to the same pointee.
+    const auto &firstIndex = indexes.front();
+    if ((firstIndex.isConstant() && firstIndex.index() == 0) || !baseParent || !baseParent->type()->isArrayTy()) {
+      addElements(baseNode, depth);
+    } else if (firstIndex.isConstant()) {
+      // All elements of a smashed array share the summary element, which is always the pointee itself.
+      auto sibling = baseParent->GetElement(baseNode->offset() + firstIndex.index());
+      addElements(sibling ? sibling : baseNode, depth);
+    } else {
+      for (size_t i = 0; i < baseParent->GetNumChildren(); ++i) {
+        addElements(baseParent->GetChild(i), depth);
+      }
     }
   }
 
-  return converged;
+  auto &state = GetState(pointer);
+  if (!state.pointees.MergeFrom(elements, state.delta)) {
+    return false;
+  }
+  Enqueue(pointer, state);
+  return true;
 }
 
-bool PointsToSolver::RelaxPointeeAssigned(Pointer *pointer, const PointeeAssignedPointer &edge) noexcept {
-  auto converged = true;
+const std::vector<unsigned>& PointsToSolver::GetElementOffsets(Component &component, ValueTreeNode *node, size_t depth,
+                                                                IndexSequence indexSequence) noexcept {
+  auto key = std::make_pair(node->type(), (static_cast<uint64_t>(depth) << 32) | indexSequence.id());
+  auto result = component.elementOffsets.try_emplace(key);
+  auto &offsets = result.first->second;
+  if (!result.second) {
+    return offsets;
+  }
 
-  auto rhsPointer = edge.pointer();
-  for (auto pointee : pointer->GetPointeeSet()) {
-    assert(pointee->isPointer());
-    if (pointee->pointer()->AssignedPointer(rhsPointer)) {
-      converged = false;
+  // The remaining indexes step into sub-objects of the node. Field-insensitive aggregates stand for all of their
+  // sub-objects.
+  auto indexes = indexSequence.indexes();
+  std::vector<ValueTreeNode *> elementNodes { node };
+  std::vector<ValueTreeNode *> nextElementNodes;
+  for (auto it = std::next(indexes.begin()); it != indexes.end(); ++it) {
+    const auto &index = *it;
+    nextElementNodes.clear();
+    for (auto elementNode : elementNodes) {
+      if (!elementNode->type()->isArrayTy() && !elementNode->type()->isStructTy()) {
+        continue;
+      }
+      if (index.isConstant()) {
+        if (auto element = elementNode->GetElement(index.index())) {
+          nextElementNodes.push_back(element);
+        }
+      } else if (elementNode->isFieldInsensitive()) {
+        nextElementNodes.push_back(elementNode);
+      } else {
+        for (size_t i = 0; i < elementNode->GetNumChildren(); ++i) {
+          nextElementNodes.push_back(elementNode->GetChild(i));
+        }
+      }
     }
+    elementNodes.swap(nextElementNodes);
   }
 
-  return converged;
+  auto baseId = node->pointee()->id();
+  offsets.reserve(elementNodes.size());
+  for (auto elementNode : elementNodes) {
+    offsets.push_back(static_cast<unsigned>(elementNode->pointee()->id() - baseId));
+  }
+  return offsets;
 }
 
 } // namespace anderson
 
-} // namespace llvm
\ No newline at end of file
+} // namespace llvm
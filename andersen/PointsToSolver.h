@@ -3,51 +3,650 @@
 
 #include "AndersonPointsToAnalysis.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <utility>
+#include <vector>
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/STLFunctionalExtras.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/Support/raw_ostream.h>
 
 namespace llvm {
 
 namespace anderson {
 
+/**
+ * The destination of the constraints gathered from the instructions of a function.
+ *
+ * Functions may be gathered concurrently into different graphs, so a gatherer only reads the value tree and interns
+ * index sequences into a table that belongs to the graph it gathers into.
+ */
+class ConstraintGatherer {
+public:
+  /**
+   * Construct a new ConstraintGatherer object.
+   *
+   * @param valueTree the value tree of the module, which is only read.
+   * @param constraints the graph that receives the constraints.
+   * @param indexSequences the table that interns the index sequences of the constraints added to `constraints`.
+   */
+  explicit ConstraintGatherer(ValueTree &valueTree, ConstraintGraph &constraints,
+                              IndexSequenceTable &indexSequences) noexcept
+    : _valueTree(valueTree),
+      _constraints(constraints),
+      _indexSequences(indexSequences)
+  { }
+
+  NON_COPIABLE_NON_MOVABLE(ConstraintGatherer)
+
+  ValueTree* GetValueTree() const noexcept {
+    return &_valueTree;
+  }
+
+  ConstraintGraph& GetConstraintGraph() const noexcept {
+    return _constraints;
+  }
+
+  IndexSequenceTable& GetIndexSequenceTable() const noexcept {
+    return _indexSequences;
+  }
+
+private:
+  ValueTree &_valueTree;
+  ConstraintGraph &_constraints;
+  IndexSequenceTable &_indexSequences;
+};
+
 class PointsToSolver {
 public:
-  explicit PointsToSolver(const llvm::Module &module) noexcept
+  /**
+   * Counters and timers of the solver, collected only when statistics are enabled.
+   */
+  struct Statistics {
+    /**
+     * The kinds of edges along which pointees are propagated.
+     */
+    enum EdgeKind : size_t {
+      /**
+       * `p = q`, including the edges discovered while solving.
+       */
+      Copy,
+
+      /**
+       * `p = &q[...]`.
+       */
+      ElementPtr,
+
+      /**
+       * `p = *q`, which turns every pointee of `q` into a copy edge.
+       */
+      AssignedPointee,
+
+      /**
+       * `*p = q`, which turns every pointee of `p` into a copy edge.
+       */
+      PointeeAssigned,
+
+      /**
+       * `p = (*q)(...)` and `(*q)(..., r, ...)`, which turn every function pointed to by `q` into copy edges of its
+       * return value and its parameters.
+       */
+      Call,
+
+      NumEdgeKinds,
+    };
+
+    /**
+     * The phases of solving.
+     */
+    enum Phase : size_t {
+      Partition,
+      OfflineEquivalence,
+      Initialize,
+      Propagate,
+      Finalize,
+      NumPhases,
+    };
+
+    /**
+     * The number of pointers taken from the worklists.
+     */
+    size_t numPops = 0;
+
+    /**
+     * The number of cycle detections and the time spent in them.
+     */
+    size_t numCycleDetections = 0;
+    uint64_t cycleDetectionNanoseconds = 0;
+
+    /**
+     * The number of times an edge of each kind has been relaxed, the number of relaxations that changed the pointee
+     * set or the edges of the target, and the time spent in them. The times of concurrently solved components add up.
+     */
+    std::array<size_t, NumEdgeKinds> relaxations { };
+    std::array<size_t, NumEdgeKinds> changes { };
+    std::array<uint64_t, NumEdgeKinds> nanoseconds { };
+
+    /**
+     * The wall time spent in each phase.
+     */
+    std::array<uint64_t, NumPhases> phaseNanoseconds { };
+
+    void MergeFrom(const Statistics &another) noexcept;
+  };
+
+  /**
+   * Limits on the work of a single solve or update. When a limit is reached, propagation stops and the pointers of the
+   * components that have not converged are widened: the pointee set of each of them becomes all memory values of its
+   * component, which is sound since pointee sets never leave their component. Widened pointers are flagged by
+   * `Pointer::isWidened`. A limit of 0 means no limit.
+   */
+  struct Budget {
+    /**
+     * The wall time of a solve or update, in milliseconds.
+     */
+    uint64_t milliseconds = 0;
+
+    /**
+     * The number of pointers taken from the worklists.
+     */
+    uint64_t pops = 0;
+
+    /**
+     * The heap usage of the process, in megabytes.
+     */
+    uint64_t megabytes = 0;
+
+    bool isLimited() const noexcept {
+      return milliseconds || pops || megabytes;
+    }
+  };
+
+  /**
+   * Construct a new PointsToSolver object.
+   *
+   * @param module the LLVM module to be analyzed.
+   * @param options the options that control how aggregate values are broken down into value tree nodes.
+   * @param numThreads the number of threads that build the value tree, gather the constraints and solve independent
+   * components of the constraint graph concurrently. 0 means one thread per hardware thread.
+   */
+  explicit PointsToSolver(const llvm::Module &module, const ValueTreeOptions &options = ValueTreeOptions { },
+                          unsigned numThreads = 1) noexcept
     : _module(module),
-      _valueTree(std::make_unique<ValueTree>(module))
+      _valueTree(std::make_unique<ValueTree>(module, options, numThreads)),
+      _states(),
+      _componentIds(),
+      _componentSizes(),
+      _components(),
+      _offlineEquivalence(true),
+      _numThreads(numThreads),
+      _numEquivalentPointers(0),
+      _numCollapsedPointers(0),
+      _numSolvedComponents(0),
+      _collectStatistics(false),
+      _statistics(),
+      _budget(),
+      _budgetDeadline(),
+      _budgetPops(0),
+      _budgetExceeded(false),
+      _numWidenedPointers(0),
+      _incremental(false),
+      _functionRecords(),
+      _globals(),
+      _currentFunction(nullptr),
+      _currentConstraints(),
+      _addedConstraints(),
+      _removedConstraints(false)
   { }
 
   ValueTree* GetValueTree() const noexcept {
     return _valueTree.get();
   }
 
+  /**
+   * Get the graph that gathers the constraints of the program.
+   *
+   * @return the graph that gathers the constraints of the program.
+   */
+  ConstraintGraph& GetConstraintGraph() const noexcept {
+    return _valueTree->GetConstraintGraph();
+  }
+
   std::unique_ptr<ValueTree> TakeValueTree() noexcept {
     return std::move(_valueTree);
   }
 
+  /**
+   * Set the representation of the pointee sets computed by the solver.
+   *
+   * @param representation the representation of pointee sets.
+   */
+  void SetPointeeSetRepresentation(PointeeSetRepresentation representation) noexcept {
+    _valueTree->GetPointeeTable().SetRepresentation(representation);
+  }
+
+  /**
+   * Set whether pointers with provably identical pointee sets are merged by an offline pass before solving.
+   *
+   * @param enabled whether the offline pointer equivalence pass is enabled.
+   */
+  void SetOfflineEquivalence(bool enabled) noexcept {
+    _offlineEquivalence = enabled;
+  }
+
+  /**
+   * Set the number of threads that gather the constraints of different functions and solve independent components of
+   * the constraint graph concurrently. The points-to results do not depend on the number of threads.
+   *
+   * @param numThreads the number of threads. 0 means one thread per hardware thread.
+   */
+  void SetNumThreads(unsigned numThreads) noexcept {
+    _numThreads = numThreads;
+  }
+
+  /**
+   * Set whether the solver keeps its state after solving, so that the solution can be updated after functions in the
+   * module are changed or added. Offline pointer equivalence is skipped in incremental mode since pointers that are
+   * equivalent now may no longer be equivalent after an update.
+   *
+   * @param enabled whether incremental mode is enabled.
+   */
+  void SetIncremental(bool enabled) noexcept {
+    _incremental = enabled;
+  }
+
+  /**
+   * Determine whether the solver is in incremental mode.
+   *
+   * @return whether the solver is in incremental mode.
+   */
+  bool isIncremental() const noexcept {
+    return _incremental;
+  }
+
+  /**
+   * Gather the constraints of the specified functions. The constraints of each function are added by `gather`, which
+   * reads the function and adds its constraints through the specified gatherer.
+   *
+   * Outside of incremental mode, the functions are split into contiguous chunks that are gathered concurrently into
+   * graphs of their own, which are then appended to the constraint graph in the order of the chunks. The resulting
+   * constraint graph does not depend on the number of threads.
+   *
+   * @param functions the functions.
+   * @param gather the function that gathers the constraints of a single function.
+   */
+  void GatherFunctions(llvm::ArrayRef<const llvm::Function *> functions,
+                       llvm::function_ref<void(ConstraintGatherer &, const llvm::Function &)> gather) noexcept;
+
   void Solve() noexcept;
 
+  /**
+   * Prepare an incremental update of the solution after the specified functions have been changed or added to the
+   * module.
+   *
+   * @param changedFunctions the functions that have been changed or added to the module.
+   * @param functions the vector that receives the functions whose constraints have to be gathered again before calling
+   * `Update`. It contains the changed functions and the functions that have never been seen by the solver.
+   * @return whether the solution can be updated incrementally. If false, something has been deleted from the module and
+   * the module has to be solved from scratch.
+   */
+  bool BeginUpdate(llvm::ArrayRef<const llvm::Function *> changedFunctions,
+                   std::vector<const llvm::Function *> &functions) noexcept;
+
+  /**
+   * Update the solution with the constraints gathered since the last call to `BeginUpdate`, propagating pointees only
+   * from the pointers that the new constraints affect.
+   *
+   * @return whether the solution has been updated. If false, some constraint of a changed function has been removed and
+   * the module has to be solved from scratch.
+   */
+  bool Update() noexcept;
+
+  /**
+   * Get the number of independent components of the constraint graph that have been solved.
+   *
+   * @return the number of independent components that have been solved.
+   */
+  size_t GetNumSolvedComponents() const noexcept {
+    return _numSolvedComponents;
+  }
+
+  /**
+   * Get the number of pointers that have been merged into another pointer by the offline pointer equivalence pass.
+   *
+   * @return the number of pointers merged before solving.
+   */
+  size_t GetNumEquivalentPointers() const noexcept {
+    return _numEquivalentPointers;
+  }
+
+  /**
+   * Get the number of pointers that have been merged into another pointer because they lie on a cycle of copy
+   * constraints.
+   *
+   * @return the number of pointers merged by cycle collapsing.
+   */
+  size_t GetNumCollapsedPointers() const noexcept {
+    return _numCollapsedPointers;
+  }
+
+  /**
+   * Set the limits on the work of each solve and update.
+   *
+   * @param budget the limits.
+   */
+  void SetBudget(const Budget &budget) noexcept {
+    _budget = budget;
+  }
+
+  /**
+   * Determine whether the last solve or update has run out of its budget and widened some pointers.
+   *
+   * @return whether the last solve or update has run out of its budget.
+   */
+  bool isBudgetExceeded() const noexcept {
+    return _budgetExceeded.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Get the number of pointers whose pointee sets have been widened because the solver ran out of its budget.
+   *
+   * @return the number of widened pointers.
+   */
+  size_t GetNumWidenedPointers() const noexcept {
+    return _numWidenedPointers;
+  }
+
+  /**
+   * Set whether the solver collects statistics. Statistics cost a few branches per worklist pop when disabled.
+   *
+   * @param enabled whether statistics are collected.
+   */
+  void SetCollectStatistics(bool enabled) noexcept {
+    _collectStatistics = enabled;
+  }
+
+  /**
+   * Get the statistics collected so far.
+   *
+   * @return the statistics collected so far.
+   */
+  const Statistics& GetStatistics() const noexcept {
+    return _statistics;
+  }
+
+  /**
+   * Write the statistics of the solver together with statistics of the solved value tree as JSON: pointee set size
+   * histogram, the largest pointee sets and the values that own them, and a breakdown of the value tree by ValueKind.
+   *
+   * @param os the output stream.
+   */
+  void WriteStatistics(llvm::raw_ostream &os) const noexcept;
+
 private:
-  static bool RelaxNode(ValueTreeNode &node) noexcept;
+  /**
+   * The number of cycle candidates collected before a cycle detection runs.
+   */
+  static constexpr size_t CycleDetectionBatchSize = 64;
+
+  /**
+   * The number of pointers a component takes from its worklist between two checks of the budget.
+   */
+  static constexpr size_t BudgetCheckInterval = 1024;
+
+  /**
+   * Per-pointer bookkeeping of the worklist solver.
+   */
+  struct PointerState {
+    explicit PointerState(const PointeeTable *table) noexcept
+      : pointees(table),
+        delta(table),
+        copyUsers(),
+        elementPtrUsers(),
+        pointeeUsers(),
+        pointeeAssignedSources(),
+        returnValueUsers(),
+        argumentSources(),
+        dynamicSources()
+    { }
+
+    /**
+     * The pointee set of the pointer while solving. It is interned into the pointer once solving completes.
+     */
+    PointeeSet pointees;
+
+    /**
+     * Pointees that have been added to the pointee set of the pointer but have not been propagated yet.
+     */
+    PointeeSet delta;
+
+    /**
+     * Pointers `p` such that `p = this` is a constraint in the program.
+     */
+    std::vector<Pointer *> copyUsers;
+
+    /**
+     * Pointers `p` together with the index sequence of the constraint `p = &this[...]` that refers to this pointer.
+     */
+    std::vector<std::pair<Pointer *, IndexSequence>> elementPtrUsers;
+
+    /**
+     * Pointers `p` such that `p = *this` is a constraint in the program.
+     */
+    std::vector<Pointer *> pointeeUsers;
+
+    /**
+     * Pointers `q` such that `*this = q` is a constraint in the program.
+     */
+    std::vector<Pointer *> pointeeAssignedSources;
 
-  static bool RelaxAssignedPointee(Pointer *pointer, const PointerAssignedPointee &edge) noexcept;
+    /**
+     * Pointers `p` such that `p = (*this)(...)` is a constraint in the program.
+     */
+    std::vector<Pointer *> returnValueUsers;
 
-  static bool RelaxAssignedElementPtr(Pointer *pointer, const PointerAssignedElementPtr &edge) noexcept;
+    /**
+     * Pointers `q` together with their argument positions such that `(*this)(..., q, ...)` is a constraint in the
+     * program.
+     */
+    std::vector<std::pair<unsigned, Pointer *>> argumentSources;
 
-  static bool RelaxPointeeAssigned(Pointer *pointer, const PointeeAssignedPointer &edge) noexcept;
+    /**
+     * Pointers `q` such that `this = q` has been discovered while solving or added by an incremental update, and is
+     * not looked up in the constraint graph.
+     */
+    llvm::SmallDenseSet<Pointer *, 4> dynamicSources;
+
+    /**
+     * The parent of the pointer in the union-find forest of collapsed cycles. Null if the pointer represents itself.
+     */
+    Pointer *parent = nullptr;
+
+    /**
+     * Whether the pointer is currently in the worklist.
+     */
+    bool queued = false;
+  };
+
+  /**
+   * Bookkeeping of an independent component of the constraint graph. Pointers in different components never interact,
+   * so each component is solved on its own and different components can be solved concurrently.
+   */
+  struct Component {
+    /**
+     * Pointers whose pending pointees have not been propagated yet.
+     */
+    std::deque<Pointer *> worklist;
+
+    /**
+     * Copy edges whose two ends hold identical pointee sets and have not been checked for cycles yet.
+     */
+    std::vector<std::pair<Pointer *, Pointer *>> cycleCandidates;
+
+    /**
+     * Copy edges that have already been reported as cycle candidates.
+     */
+    llvm::DenseSet<uint64_t> checkedCopyEdges;
+
+    /**
+     * Resolved `p = &q[...]` constraints. The key is the type and the depth of a node in the value tree together
+     * with the ID of an index sequence, and the value lists the offsets of the pointee IDs of the sub-objects selected
+     * by all but the first index, relative to the pointee ID of the node. Nodes with equal types at equal depths have
+     * identical subtrees, whose pointee IDs are assigned in pre-order, so the offsets are shared among them.
+     */
+    llvm::DenseMap<std::pair<const llvm::Type *, uint64_t>, std::vector<unsigned>> elementOffsets;
+
+    /**
+     * The number of pointers in this component.
+     */
+    size_t numPointers = 0;
+
+    /**
+     * The number of pointers in this component that have been merged into another pointer by cycle collapsing.
+     */
+    size_t numCollapsedPointers = 0;
+
+    /**
+     * Statistics of this component, merged into the statistics of the solver once the component is solved.
+     */
+    Statistics statistics;
+  };
 
   const llvm::Module &_module;
   std::unique_ptr<ValueTree> _valueTree;
+  std::vector<std::unique_ptr<PointerState>> _states;
+  std::vector<unsigned> _componentIds;
+  std::vector<size_t> _componentSizes;
+  std::vector<std::unique_ptr<Component>> _components;
+  bool _offlineEquivalence;
+  unsigned _numThreads;
+  size_t _numEquivalentPointers;
+  size_t _numCollapsedPointers;
+  size_t _numSolvedComponents;
+  bool _collectStatistics;
+  Statistics _statistics;
+
+  Budget _budget;
+  std::chrono::steady_clock::time_point _budgetDeadline;
+
+  /**
+   * The number of pointers taken from the worklists since the last solve or update started, as reported by the
+   * components at each check of the budget.
+   */
+  std::atomic<uint64_t> _budgetPops;
+  std::atomic<bool> _budgetExceeded;
+  size_t _numWidenedPointers;
+
+  /**
+   * The constraints contributed by a function, kept in incremental mode.
+   */
+  struct FunctionRecord {
+    /**
+     * The function and its instructions. A handle becomes null once its value is deleted.
+     */
+    std::vector<llvm::WeakVH> values;
+
+    /**
+     * The keys of the constraints contributed by the function, sorted and without duplicates.
+     */
+    std::vector<ConstraintKey> constraints;
+  };
+
+  bool _incremental;
+  llvm::DenseMap<const llvm::Function *, FunctionRecord> _functionRecords;
+  std::vector<llvm::WeakVH> _globals;
+  const llvm::Function *_currentFunction;
+  std::vector<ConstraintKey> _currentConstraints;
+
+  /**
+   * Keys of the constraints that have been added since the last solve.
+   */
+  std::vector<ConstraintKey> _addedConstraints;
+
+  /**
+   * Whether some constraint of a changed function has been removed since the last solve.
+   */
+  bool _removedConstraints;
+
+  /**
+   * Start gathering the constraints of the specified function. Every constraint added to the constraint graph until
+   * the matching call to `EndFunction` is attributed to the function.
+   *
+   * @param function the function.
+   */
+  void BeginFunction(const llvm::Function &function) noexcept;
+
+  /**
+   * Finish gathering the constraints of the function passed to the last call to `BeginFunction`.
+   */
+  void EndFunction() noexcept;
 
   void AddTrivialPointerAssignments() const noexcept;
 
-  void RelaxPointsToConstraints() const noexcept;
+  void AddTrivialPointerAssignments(const llvm::Function &function, ConstraintGraph &constraints) const noexcept;
+
+  void StartBudget() noexcept;
+
+  bool ChargeBudget(uint64_t numPops) noexcept;
+
+  void SolveComponents() noexcept;
+
+  void WidenUnsolvedComponents() noexcept;
+
+  void AddConstraint(const ConstraintKey &key) noexcept;
+
+  void PartitionComponents() noexcept;
+
+  Component& GetComponent(const Pointer *pointer) noexcept;
+
+  void SolveComponent(Component &component) noexcept;
+
+  void MergeEquivalentPointers() noexcept;
+
+  void InitializeWorklist() noexcept;
+
+  PointerState& GetState(const Pointer *pointer) noexcept;
+
+  Pointer* FindRepresentative(Pointer *pointer) noexcept;
+
+  void DetectAndCollapseCycles(Component &component) noexcept;
+
+  void CollapsePointer(Pointer *representative, Pointer *pointer) noexcept;
+
+  void FinalizePointeeSets() noexcept;
+
+  void Enqueue(Pointer *pointer, PointerState &state) noexcept;
+
+  void ProcessPointer(Pointer *pointer) noexcept;
+
+  bool AddAssignedPointer(Pointer *pointer, Pointer *rhsPointer) noexcept;
+
+  bool AddCalleeReturnValue(Pointer *pointer, const Pointee *callee) noexcept;
+
+  bool AddCalleeArgument(const Pointee *callee, unsigned argNo, Pointer *argument) noexcept;
+
+  void AddCopyEdge(Pointer *pointer, Pointer *rhsPointer) noexcept;
+
+  void AddPointee(Pointer *pointer, Pointee *pointee) noexcept;
+
+  bool PropagateAssignedElementPtr(Component &component, Pointer *pointer, IndexSequence indexSequence,
+                                   const PointeeSet &pointees) noexcept;
+
+  const std::vector<unsigned>& GetElementOffsets(Component &component, ValueTreeNode *node, size_t depth,
+                                                 IndexSequence indexSequence) noexcept;
 };
 
 } // namespace anderson
 
 } // namespace llvm
 
-#endif // LLVM_ANDERSON_SRC_POINTS_TO_SOLVER_H
\ No newline at end of file
+#endif // LLVM_ANDERSON_SRC_POINTS_TO_SOLVER_H
@@ -0,0 +1,208 @@
+#include "PointsToSolver.h"
+
+#include <algorithm>
+#include <string>
+
+#include <llvm/Support/JSON.h>
+
+namespace llvm {
+
+namespace anderson {
+
+namespace {
+
+/**
+ * The number of largest pointee sets listed in the statistics.
+ */
+constexpr size_t NumLargestPointeeSets = 16;
+
+/**
+ * The number of value kinds; the statistics of the value tree are broken down by the kind of the root of each node.
+ */
+constexpr size_t NumValueKinds = static_cast<size_t>(ValueKind::FunctionMemory) + 1;
+
+const char *GetEdgeKindName(size_t kind) noexcept {
+  switch (kind) {
+    case PointsToSolver::Statistics::Copy: return "copy";
+    case PointsToSolver::Statistics::ElementPtr: return "elementPtr";
+    case PointsToSolver::Statistics::AssignedPointee: return "assignedPointee";
+    case PointsToSolver::Statistics::PointeeAssigned: return "pointeeAssigned";
+    case PointsToSolver::Statistics::Call: return "call";
+    default: llvm_unreachable("unexpected edge kind");
+  }
+}
+
+const char *GetPhaseName(size_t phase) noexcept {
+  switch (phase) {
+    case PointsToSolver::Statistics::Partition: return "partition";
+    case PointsToSolver::Statistics::OfflineEquivalence: return "offlineEquivalence";
+    case PointsToSolver::Statistics::Initialize: return "initialize";
+    case PointsToSolver::Statistics::Propagate: return "propagate";
+    case PointsToSolver::Statistics::Finalize: return "finalize";
+    default: llvm_unreachable("unexpected phase");
+  }
+}
+
+const char *GetValueKindName(ValueKind kind) noexcept {
+  switch (kind) {
+    case ValueKind::Normal: return "normal";
+    case ValueKind::StackMemory: return "stackMemory";
+    case ValueKind::GlobalMemory: return "globalMemory";
+    case ValueKind::ArgumentMemory: return "argumentMemory";
+    case ValueKind::FunctionReturnValue: return "functionReturnValue";
+    case ValueKind::FunctionMemory: return "functionMemory";
+    default: llvm_unreachable("unexpected value kind");
+  }
+}
+
+double ToMilliseconds(uint64_t nanoseconds) noexcept {
+  return static_cast<double>(nanoseconds) / 1e6;
+}
+
+/**
+ * Get a readable name of the specified node: the kind and the value of its root, qualified by the enclosing function,
+ * followed by the offsets of the sub-objects leading to the node.
+ */
+std::string GetNodeName(const ValueTreeNode *node) noexcept {
+  std::string path;
+  while (node->parent()) {
+    path = "." + std::to_string(node->offset()) + path;
+    node = node->parent();
+  }
+
+  std::string name;
+  llvm::raw_string_ostream os { name };
+  os << GetValueKindName(node->kind()) << ":";
+  auto value = node->value();
+  if (auto arg = llvm::dyn_cast<llvm::Argument>(value)) {
+    os << arg->getParent()->getName() << ":arg" << arg->getArgNo();
+  } else if (auto inst = llvm::dyn_cast<llvm::Instruction>(value)) {
+    os << inst->getFunction()->getName() << ":";
+    inst->printAsOperand(os, false);
+  } else {
+    value->printAsOperand(os, false);
+  }
+  os << path;
+  return os.str();
+}
+
+} // namespace <anonymous>
+
+void PointsToSolver::WriteStatistics(llvm::raw_ostream &os) const noexcept {
+  const auto &table = _valueTree->GetPointeeTable();
+
+  // Pointee set sizes, bucketed by powers of two: bucket 0 holds empty sets and bucket `k` holds sizes in
+  // `[2^(k-1), 2^k)`.
+  std::vector<size_t> histogram;
+  std::vector<const Pointer *> pointers;
+  std::array<size_t, NumValueKinds> numRoots { };
+  std::array<size_t, NumValueKinds> numPointees { };
+  std::array<size_t, NumValueKinds> numPointers { };
+  for (size_t id = 0; id < table.size(); ++id) {
+    auto pointee = table.GetPointee(id);
+    auto node = pointee->node();
+    if (!node->parent()) {
+      auto kind = static_cast<size_t>(node->kind());
+      ++numRoots[kind];
+      numPointees[kind] += node->GetNumPointees();
+      numPointers[kind] += node->GetNumPointers();
+    }
+    if (!pointee->isPointer()) {
+      continue;
+    }
+
+    auto size = pointee->pointer()->GetPointeeSet().size();
+    size_t bucket = 0;
+    while (size >> bucket) {
+      ++bucket;
+    }
+    if (histogram.size() <= bucket) {
+      histogram.resize(bucket + 1, 0);
+    }
+    ++histogram[bucket];
+    pointers.push_back(pointee->pointer());
+  }
+
+  auto numLargest = std::min(pointers.size(), NumLargestPointeeSets);
+  std::partial_sort(pointers.begin(), pointers.begin() + numLargest, pointers.end(),
+                    [](const Pointer *lhs, const Pointer *rhs) noexcept {
+                      auto lhsSize = lhs->GetPointeeSet().size();
+                      auto rhsSize = rhs->GetPointeeSet().size();
+                      return lhsSize != rhsSize ? lhsSize > rhsSize : lhs->id() < rhs->id();
+                    });
+  pointers.resize(numLargest);
+
+  llvm::json::OStream json { os, 2 };
+  json.object([&] {
+    json.attributeObject("solver", [&] {
+      json.attribute("pops", static_cast<int64_t>(_statistics.numPops));
+      json.attribute("solvedComponents", static_cast<int64_t>(_numSolvedComponents));
+      json.attribute("equivalentPointers", static_cast<int64_t>(_numEquivalentPointers));
+      json.attribute("collapsedPointers", static_cast<int64_t>(_numCollapsedPointers));
+      json.attribute("budgetExceeded", isBudgetExceeded());
+      json.attribute("widenedPointers", static_cast<int64_t>(_numWidenedPointers));
+      json.attribute("cycleDetections", static_cast<int64_t>(_statistics.numCycleDetections));
+      json.attribute("cycleDetectionMs", ToMilliseconds(_statistics.cycleDetectionNanoseconds));
+      json.attributeObject("phaseMs", [&] {
+        for (size_t phase = 0; phase < Statistics::NumPhases; ++phase) {
+          json.attribute(GetPhaseName(phase), ToMilliseconds(_statistics.phaseNanoseconds[phase]));
+        }
+      });
+      json.attributeObject("edges", [&] {
+        for (size_t kind = 0; kind < Statistics::NumEdgeKinds; ++kind) {
+          json.attributeObject(GetEdgeKindName(kind), [&] {
+            json.attribute("relaxations", static_cast<int64_t>(_statistics.relaxations[kind]));
+            json.attribute("changes", static_cast<int64_t>(_statistics.changes[kind]));
+            json.attribute("ms", ToMilliseconds(_statistics.nanoseconds[kind]));
+          });
+        }
+      });
+    });
+
+    json.attribute("constraints", static_cast<int64_t>(_valueTree->GetConstraintGraph().GetNumConstraints()));
+
+    json.attributeObject("pointeeSets", [&] {
+      json.attribute("distinct", static_cast<int64_t>(_valueTree->GetPointeeSetPool().size()));
+      json.attributeArray("sizeHistogram", [&] {
+        for (size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+          json.object([&] {
+            json.attribute("min", static_cast<int64_t>(bucket ? size_t { 1 } << (bucket - 1) : 0));
+            json.attribute("max", static_cast<int64_t>(bucket ? (size_t { 1 } << bucket) - 1 : 0));
+            json.attribute("pointers", static_cast<int64_t>(histogram[bucket]));
+          });
+        }
+      });
+      json.attributeArray("largest", [&] {
+        for (auto pointer : pointers) {
+          json.object([&] {
+            json.attribute("value", GetNodeName(pointer->node()));
+            json.attribute("size", static_cast<int64_t>(pointer->GetPointeeSet().size()));
+          });
+        }
+      });
+    });
+
+    // Every node owns a Pointee or a Pointer allocated in the arena of the value tree.
+    json.attributeObject("valueTree", [&] {
+      json.attribute("pointees", static_cast<int64_t>(_valueTree->GetNumPointees()));
+      json.attribute("pointers", static_cast<int64_t>(_valueTree->GetNumPointers()));
+      json.attributeObject("byKind", [&] {
+        for (size_t kind = 0; kind < NumValueKinds; ++kind) {
+          json.attributeObject(GetValueKindName(static_cast<ValueKind>(kind)), [&] {
+            auto bytes = numPointees[kind] * sizeof(ValueTreeNode) + numPointers[kind] * sizeof(Pointer) +
+                (numPointees[kind] - numPointers[kind]) * sizeof(Pointee);
+            json.attribute("roots", static_cast<int64_t>(numRoots[kind]));
+            json.attribute("pointees", static_cast<int64_t>(numPointees[kind]));
+            json.attribute("pointers", static_cast<int64_t>(numPointers[kind]));
+            json.attribute("bytes", static_cast<int64_t>(bytes));
+          });
+        }
+      });
+    });
+  });
+  os << "\n";
+}
+
+} // namespace anderson
+
+} // namespace llvm
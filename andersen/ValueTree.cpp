@@ -1,52 +1,252 @@
 #include "AndersonPointsToAnalysis.h"
+#include "ParallelFor.h"
 
 namespace llvm {
 
 namespace anderson {
 
-template <typename ...Args>
-static std::unique_ptr<ValueTreeNode> CreateNode(size_t &numPointees, size_t &numPointers, Args&&... args) noexcept {
-  auto node = std::make_unique<ValueTreeNode>(std::forward<Args>(args)...);
-  numPointees += node->GetNumPointees();
-  numPointers += node->GetNumPointers();
-  return node;
-}
+static_assert(std::is_trivially_destructible<ValueTreeNode>::value,
+              "ValueTreeNode objects are released with the arena without running their destructors");
+static_assert(std::is_trivially_destructible<Pointee>::value,
+              "Pointee objects are released with the arena without running their destructors");
 
-ValueTree::ValueTree(const llvm::Module &module) noexcept
+ValueTree::ValueTree(const llvm::Module &module, const ValueTreeOptions &options, unsigned numThreads) noexcept
   : _module(module),
-    _roots(),
-    _allocaMemoryRoots(),
-    _globalMemoryRoots(),
-    _argumentMemoryRoots(),
-    _returnValueRoots(),
+    _options(options),
+    _allocators(),
+    _valueIndexes(),
+    _valueRoots(),
+    _numRoots(),
+    _pointeeTable(),
+    _pointeeSetPool(&_pointeeTable),
+    _indexSequences(),
     _numPointees(0),
     _numPointers(0)
 {
+  std::vector<const llvm::Function *> functions;
   for (const auto &globalVariable : module.globals()) {
-    _roots[&globalVariable] = CreateNode(_numPointees, _numPointers, &globalVariable);
-    _globalMemoryRoots[&globalVariable] = CreateNode(_numPointees, _numPointers, GlobalMemoryValueTag { }, &globalVariable);
+    GetRoots(&globalVariable);
   }
-
   for (const auto &func : module) {
-    _roots[&func] = CreateNode(_numPointees, _numPointers, &func);
-    _returnValueRoots[&func] = CreateNode(_numPointees, _numPointers, FunctionReturnValueTag { }, &func);
-    for (const auto &arg : func.args()) {
-      _roots[&arg] = CreateNode(_numPointees, _numPointers, ArgumentMemoryValueTag { }, &arg);
-    }
-    for (const auto &bb : func) {
-      for (const auto &inst : bb) {
-        _roots[&inst] = CreateNode(_numPointees, _numPointers, &inst);
-        auto allocaInst = llvm::dyn_cast<llvm::AllocaInst>(&inst);
-        if (allocaInst) {
-          _allocaMemoryRoots[allocaInst] = CreateNode(_numPointees, _numPointers, StackMemoryValueTag { }, allocaInst);
+    NumberValues(func);
+    functions.push_back(&func);
+  }
+
+  // Pointee IDs are assigned in the order the nodes are created. Only memory values can be pointed to, so creating them
+  // first keeps the IDs in pointee sets within a narrow range, which keeps the sparse bitvectors dense.
+  //
+  // The value trees of different functions are independent, so each batch of roots below is built by whichever thread
+  // picks it up, in the arena of that thread. The IDs are assigned afterwards, batch by batch in the order listed, so
+  // they are the same as if the batches had been built one after another.
+  auto numFunctions = functions.size();
+  std::vector<std::vector<Pointee *>> batches(2 * numFunctions + 2);
+  auto numWorkers = GetNumWorkerThreads(numThreads, batches.size());
+  for (unsigned i = 0; i < numWorkers; ++i) {
+    _allocators.emplace_back();
+  }
+
+  ParallelFor(batches.size(), numThreads, [&](size_t index, unsigned thread) noexcept {
+    auto &allocator = _allocators[thread];
+    auto &pointees = batches[index];
+    if (index == 0) {
+      for (const auto &globalVariable : module.globals()) {
+        FindRoots(&globalVariable)->memory = CreateRoot(allocator, pointees, GlobalMemoryValueTag { }, &globalVariable);
+      }
+    } else if (index <= numFunctions) {
+      CreateMemoryRoots(*functions[index - 1], allocator, pointees);
+    } else if (index == numFunctions + 1) {
+      for (const auto &globalVariable : module.globals()) {
+        FindRoots(&globalVariable)->value = CreateRoot(allocator, pointees, &globalVariable);
+      }
+    } else {
+      CreateValueRoots(*functions[index - numFunctions - 2], allocator, pointees);
+    }
+  });
+
+  size_t numPointees = 0;
+  for (const auto &pointees : batches) {
+    numPointees += pointees.size();
+  }
+  _pointeeTable.reserve(numPointees);
+  for (const auto &pointees : batches) {
+    AddPointees(pointees);
+  }
+}
+
+void ValueTree::AddFunction(const llvm::Function &function) noexcept {
+  NumberValues(function);
+  std::vector<Pointee *> pointees;
+  CreateMemoryRoots(function, _allocators.front(), pointees);
+  CreateValueRoots(function, _allocators.front(), pointees);
+  AddPointees(pointees);
+}
+
+void ValueTree::NumberValues(const llvm::Function &function) noexcept {
+  // Values that cannot hold a pointer never take part in a constraint, so they are neither numbered nor given a value
+  // tree. Memory values are complete nonetheless, since pointers may point to any of their fields.
+  GetRoots(&function);
+  for (const auto &arg : function.args()) {
+    if (ContainsPointer(arg.getType())) {
+      GetRoots(&arg);
+    }
+  }
+  for (const auto &bb : function) {
+    for (const auto &inst : bb) {
+      if (ContainsPointer(inst.getType())) {
+        GetRoots(&inst);
+      }
+    }
+  }
+}
+
+ValueTree::ValueRoots& ValueTree::GetRoots(const llvm::Value *value) noexcept {
+  auto result = _valueIndexes.try_emplace(value, static_cast<unsigned>(_valueRoots.size()));
+  if (result.second) {
+    _valueRoots.emplace_back();
+  }
+  return _valueRoots[result.first->second];
+}
+
+void ValueTree::CreateMemoryRoots(const llvm::Function &function, llvm::BumpPtrAllocator &allocator,
+                                  std::vector<Pointee *> &pointees) noexcept {
+  // The values have been numbered already, so only their roots are written and the roots of different functions can
+  // be created concurrently.
+  auto &functionRoot = FindRoots(&function)->memory;
+  if (!functionRoot) {
+    functionRoot = CreateRoot(allocator, pointees, FunctionMemoryValueTag { }, &function);
+  }
+  for (const auto &arg : function.args()) {
+    if (!arg.getType()->isPointerTy()) {
+      continue;
+    }
+    auto &root = FindRoots(&arg)->memory;
+    if (!root) {
+      root = CreateRoot(allocator, pointees, ArgumentMemoryValueTag { }, &arg);
+    }
+  }
+  for (const auto &bb : function) {
+    for (const auto &inst : bb) {
+      if (auto allocaInst = llvm::dyn_cast<llvm::AllocaInst>(&inst)) {
+        auto &root = FindRoots(allocaInst)->memory;
+        if (!root) {
+          root = CreateRoot(allocator, pointees, StackMemoryValueTag { }, allocaInst);
         }
       }
     }
   }
 }
 
+void ValueTree::CreateValueRoots(const llvm::Function &function, llvm::BumpPtrAllocator &allocator,
+                                 std::vector<Pointee *> &pointees) noexcept {
+  // Roots that already exist are kept, so that the pointee IDs and the constraints referring to them stay valid.
+  auto createRoot = [this, &allocator, &pointees](auto &root, auto&&... args) noexcept {
+    if (!root) {
+      root = CreateRoot(allocator, pointees, std::forward<decltype(args)>(args)...);
+    }
+  };
+  auto &functionRoots = *FindRoots(&function);
+  createRoot(functionRoots.value, &function);
+  if (ContainsPointer(function.getReturnType())) {
+    createRoot(functionRoots.returnValue, FunctionReturnValueTag { }, &function);
+  }
+  for (const auto &arg : function.args()) {
+    if (ContainsPointer(arg.getType())) {
+      createRoot(FindRoots(&arg)->value, &arg);
+    }
+  }
+  for (const auto &bb : function) {
+    for (const auto &inst : bb) {
+      if (ContainsPointer(inst.getType())) {
+        createRoot(FindRoots(&inst)->value, &inst);
+      }
+    }
+  }
+}
+
+template <typename ...Args>
+ValueTreeNode* ValueTree::CreateRoot(llvm::BumpPtrAllocator &allocator, std::vector<Pointee *> &pointees,
+                                     Args&&... args) noexcept {
+  auto node = new (allocator.Allocate<ValueTreeNode>()) ValueTreeNode(std::forward<Args>(args)...);
+  InitializeNode(*node, 0, allocator, pointees);
+  return node;
+}
+
+void ValueTree::InitializeNode(ValueTreeNode &node, size_t depth, llvm::BumpPtrAllocator &allocator,
+                               std::vector<Pointee *> &pointees) noexcept {
+  auto type = node._type;
+  if ((type->isArrayTy() || type->isStructTy()) && depth >= _options.maxFieldDepth) {
+    node._fieldInsensitive = true;
+    node._isPointer = ContainsPointer(type);
+  }
+
+  // Pointees are collected in pre-order and receive their IDs in `AddPointees`.
+  if (node._isPointer) {
+    auto pointer = new (allocator.Allocate<Pointer>()) Pointer(node);
+    pointer->SetPointeeSet(_pointeeSetPool.GetEmptySet());
+    node._pointee = pointer;
+  } else {
+    node._pointee = new (allocator.Allocate<Pointee>()) Pointee(node);
+  }
+  pointees.push_back(node._pointee);
+
+  if (node._fieldInsensitive) {
+    node._numChildren = 0;
+  } else if (type->isArrayTy()) {
+    auto numElements = type->getArrayNumElements();
+    auto smashed = _options.smashArrays || numElements > _options.maxArrayElements;
+    node._numChildren = smashed ? std::min<size_t>(numElements, 1) : numElements;
+  } else if (type->isStructTy()) {
+    node._numChildren = type->getStructNumElements();
+  }
+
+  // The children of a node are stored contiguously, so that they can be addressed by their offsets.
+  if (node._numChildren) {
+    node._children = allocator.Allocate<ValueTreeNode>(node._numChildren);
+    for (size_t i = 0; i < node._numChildren; ++i) {
+      auto childType = type->isArrayTy() ? type->getArrayElementType() : type->getStructElementType(i);
+      new (&node._children[i]) ValueTreeNode(childType, &node, i);
+    }
+  }
+
+  node._numPointees = 1;
+  node._numPointers = static_cast<size_t>(node._isPointer);
+  for (size_t i = 0; i < node._numChildren; ++i) {
+    auto &child = node._children[i];
+    InitializeNode(child, depth + 1, allocator, pointees);
+    node._numPointees += child._numPointees;
+    node._numPointers += child._numPointers;
+  }
+}
+
+void ValueTree::AddPointees(const std::vector<Pointee *> &pointees) noexcept {
+  for (auto pointee : pointees) {
+    pointee->_id = _pointeeTable.AddPointee(pointee);
+    auto node = pointee->node();
+    if (node->isRoot()) {
+      ++_numRoots[static_cast<size_t>(node->kind())];
+    }
+    _numPointers += static_cast<size_t>(node->isPointer());
+  }
+  _numPointees += pointees.size();
+}
+
+bool ValueTree::ContainsPointer(const llvm::Type *type) noexcept {
+  if (type->isPointerTy()) {
+    return true;
+  }
+  if (type->isArrayTy()) {
+    return ContainsPointer(type->getArrayElementType());
+  }
+  if (type->isStructTy()) {
+    for (auto fieldType : type->subtypes()) {
+      if (ContainsPointer(fieldType)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 } // namespace anderson
 
-} // namespace llvm//
-// Created by Sirui Mu on 2020/12/31.
-//
+} // namespace llvm
@@ -1,22 +1,34 @@
 #include "AndersonPointsToAnalysis.h"
-#include <functional>
 
 namespace llvm {
 
 namespace anderson {
 
+static const llvm::Type* GetArgumentMemoryType(const llvm::Argument *argument) noexcept {
+  auto type = argument->getType();
+  if (type->isOpaquePointerTy()) {
+    // The pointee type of an opaque pointer is unknown. Model the argument memory as a single pointer slot so that the
+    // pointers stored in it are still tracked.
+    return type;
+  }
+  return type->getNonOpaquePointerElementType();
+}
+
 ValueTreeNode::ValueTreeNode(const llvm::Value *value) noexcept
   : _type(value->getType()),
     _value(value),
     _kind(ValueKind::Normal),
     _parent(nullptr),
     _offset(0),
-    _children(),
+    _children(nullptr),
+    _numChildren(0),
+    _pointee(nullptr),
     _numPointees(0),
-    _numPointers(0)
+    _numPointers(0),
+    _isPointer(_type->isPointerTy()),
+    _fieldInsensitive(false)
 {
   assert(value && "value cannot be null");
-  Initialize();
 }
 
 ValueTreeNode::ValueTreeNode(StackMemoryValueTag, const llvm::AllocaInst *stackMemoryAllocator) noexcept
@@ -25,12 +37,15 @@ ValueTreeNode::ValueTreeNode(StackMemoryValueTag, const llvm::AllocaInst *stackM
     _kind(ValueKind::StackMemory),
     _parent(nullptr),
     _offset(0),
-    _children(),
+    _children(nullptr),
+    _numChildren(0),
+    _pointee(nullptr),
     _numPointees(0),
-    _numPointers(0)
+    _numPointers(0),
+    _isPointer(_type->isPointerTy()),
+    _fieldInsensitive(false)
 {
   assert(stackMemoryAllocator && "stackMemoryAllocator cannot be null");
-  Initialize();
 }
 
 ValueTreeNode::ValueTreeNode(GlobalMemoryValueTag, const llvm::GlobalVariable *globalVariable) noexcept
@@ -39,34 +54,33 @@ ValueTreeNode::ValueTreeNode(GlobalMemoryValueTag, const llvm::GlobalVariable *g
     _kind(ValueKind::GlobalMemory),
     _parent(nullptr),
     _offset(0),
-    _children(),
+    _children(nullptr),
+    _numChildren(0),
+    _pointee(nullptr),
     _numPointees(0),
-    _numPointers(0)
+    _numPointers(0),
+    _isPointer(_type->isPointerTy()),
+    _fieldInsensitive(false)
 {
   assert(globalVariable && "globalVariable cannot be null");
-  Initialize();
 }
 
 ValueTreeNode::ValueTreeNode(ArgumentMemoryValueTag, const llvm::Argument *argument) noexcept
-  : 
+  : _type(GetArgumentMemoryType(argument)),
     _value(argument),
     _kind(ValueKind::ArgumentMemory),
     _parent(nullptr),
     _offset(0),
-    _children(0),
+    _children(nullptr),
+    _numChildren(0),
+    _pointee(nullptr),
     _numPointees(0),
-    _numPointers(0)
+    _numPointers(0),
+    _isPointer(_type->isPointerTy()),
+    _fieldInsensitive(false)
 {
   assert(argument && "argument cannot be null");
   assert(argument->getType()->isPointerTy() && "argument should be a pointer");
-// Check for opaque pointer types
-if (argument->getType()->isOpaquePointerTy()) {
-    _type = nullptr;  // Opaque pointers have no pointee type
-} else {
-    _type = argument->getType()->getNonOpaquePointerElementType();  // Safe to use for non-opaque pointers
-}
-
-  Initialize();
 }
 
 ValueTreeNode::ValueTreeNode(FunctionReturnValueTag, const llvm::Function *function) noexcept
@@ -75,12 +89,32 @@ ValueTreeNode::ValueTreeNode(FunctionReturnValueTag, const llvm::Function *funct
     _kind(ValueKind::FunctionReturnValue),
     _parent(nullptr),
     _offset(0),
-    _children(0),
+    _children(nullptr),
+    _numChildren(0),
+    _pointee(nullptr),
     _numPointees(0),
-    _numPointers(0)
+    _numPointers(0),
+    _isPointer(_type->isPointerTy()),
+    _fieldInsensitive(false)
+{
+  assert(function && "function cannot be null");
+}
+
+ValueTreeNode::ValueTreeNode(FunctionMemoryValueTag, const llvm::Function *function) noexcept
+  : _type(function->getFunctionType()),
+    _value(function),
+    _kind(ValueKind::FunctionMemory),
+    _parent(nullptr),
+    _offset(0),
+    _children(nullptr),
+    _numChildren(0),
+    _pointee(nullptr),
+    _numPointees(0),
+    _numPointers(0),
+    _isPointer(false),
+    _fieldInsensitive(false)
 {
   assert(function && "function cannot be null");
-  Initialize();
 }
 
 ValueTreeNode::ValueTreeNode(const llvm::Type *type, ValueTreeNode *parent, size_t offset) noexcept
@@ -89,46 +123,18 @@ ValueTreeNode::ValueTreeNode(const llvm::Type *type, ValueTreeNode *parent, size
     _kind(parent->_kind),
     _parent(parent),
     _offset(offset),
-    _children(),
+    _children(nullptr),
+    _numChildren(0),
+    _pointee(nullptr),
     _numPointees(0),
-    _numPointers(0)
+    _numPointers(0),
+    _isPointer(_type->isPointerTy()),
+    _fieldInsensitive(false)
 {
   assert(type && "type cannot be null");
   assert(parent && "parent cannot be null");
-  Initialize();
-}
-
-void ValueTreeNode::InitializeChildren() noexcept {
-  size_t numChildren = 0;
-  std::function<const llvm::Type *(size_t)> childTypeGetter;
-
-  if (_type->isArrayTy()) {
-    numChildren = _type->getArrayNumElements();
-    childTypeGetter = [this](size_t) {
-      return _type->getArrayElementType();
-    };
-  } else if (_type->isStructTy()) {
-    numChildren = _type->getStructNumElements();
-    childTypeGetter = [this](size_t index) {
-      return _type->getStructElementType(index);
-    };
-  }
-
-  if (numChildren) {
-    _children.reserve(numChildren);
-    for (size_t i = 0; i < numChildren; ++i) {
-      _children.push_back(std::make_unique<ValueTreeNode>(childTypeGetter(i), this, i));
-    }
-  }
-
-  _numPointees = 1;
-  _numPointers = static_cast<size_t>(_type->isPointerTy());
-  for (const auto &child : _children) {
-    _numPointees += child->_numPointees;
-    _numPointers += child->_numPointers;
-  }
 }
 
 } // namespace anderson
 
-} // namespace llvm
\ No newline at end of file
+} // namespace llvm